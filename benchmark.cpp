@@ -0,0 +1,227 @@
+#include "benchmark.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <execution>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t PROCESS_QUERIES_BATCH_SIZE = 64;
+// Every MatchDocuments call matches the whole corpus
+const size_t MATCH_DOCUMENTS_QUERY_COUNT = 100;
+
+size_t ParseCount(string_view name, string_view text) {
+	size_t value = 0;
+	const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+	if (error != errc() || end != text.data() + text.size()) {
+		throw invalid_argument("invalid value of benchmark option "s + string(name));
+	}
+	return value;
+}
+
+double ParseReal(string_view name, string_view text) {
+	size_t parsed = 0;
+	double value = 0.0;
+	try {
+		value = stod(string(text), &parsed);
+	}
+	catch (const exception&) {
+		parsed = 0;
+	}
+	if (parsed == 0 || parsed != text.size() || value < 0.0) {
+		throw invalid_argument("invalid value of benchmark option "s + string(name));
+	}
+	return value;
+}
+
+uint64_t GetPercentile(const vector<uint64_t>& sorted_latencies, double percentile) {
+	const size_t index = static_cast<size_t>(percentile * static_cast<double>(sorted_latencies.size() - 1) + 0.5);
+	return sorted_latencies[index];
+}
+
+// Calls call(i) for every i in [0, call_count), timing every call on its own;
+// operation_count is the number of items all the calls handle together
+template <typename Call>
+BenchmarkResult Measure(string name, size_t call_count, size_t operation_count, Call call) {
+	using Clock = chrono::steady_clock;
+	vector<uint64_t> latencies;
+	latencies.reserve(call_count);
+	for (size_t i = 0; i < call_count; ++i) {
+		const Clock::time_point start = Clock::now();
+		call(i);
+		latencies.push_back(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count()));
+	}
+
+	BenchmarkResult result;
+	result.name = move(name);
+	result.call_count = call_count;
+	result.operation_count = operation_count;
+	if (latencies.empty()) {
+		return result;
+	}
+	for (const uint64_t latency : latencies) {
+		result.total_ns += latency;
+	}
+	sort(latencies.begin(), latencies.end());
+	result.operations_per_second = static_cast<double>(result.operation_count) * 1e9 / static_cast<double>(max<uint64_t>(result.total_ns, 1));
+	result.p50_ns = GetPercentile(latencies, 0.5);
+	result.p99_ns = GetPercentile(latencies, 0.99);
+	result.p999_ns = GetPercentile(latencies, 0.999);
+	result.max_ns = latencies.back();
+	return result;
+}
+
+}
+
+BenchmarkOptions ParseBenchmarkOptions(const vector<string_view>& args) {
+	BenchmarkOptions options;
+	for (const string_view arg : args) {
+		const size_t separator = arg.find('=');
+		if (arg.substr(0, 2) != "--"sv || separator == arg.npos) {
+			throw invalid_argument("benchmark options look like --name=value");
+		}
+		const string_view name = arg.substr(2, separator - 2);
+		const string_view value = arg.substr(separator + 1);
+		if (name == "documents"sv) {
+			options.corpus.document_count = ParseCount(name, value);
+		}
+		else if (name == "vocabulary"sv) {
+			options.corpus.vocabulary_size = ParseCount(name, value);
+		}
+		else if (name == "document-words"sv) {
+			options.corpus.words_per_document = ParseCount(name, value);
+		}
+		else if (name == "query-words"sv) {
+			options.corpus.query_word_count = ParseCount(name, value);
+		}
+		else if (name == "zipf"sv) {
+			options.corpus.zipf_exponent = ParseReal(name, value);
+		}
+		else if (name == "queries"sv) {
+			options.query_count = ParseCount(name, value);
+		}
+		else if (name == "removes"sv) {
+			options.remove_count = ParseCount(name, value);
+		}
+		else if (name == "threads"sv) {
+			options.thread_count = ParseCount(name, value);
+		}
+		else if (name == "seed"sv) {
+			options.corpus.seed = ParseCount(name, value);
+		}
+		else if (name == "format"sv && (value == "json"sv || value == "csv"sv)) {
+			options.format = value == "json"sv ? BenchmarkFormat::JSON : BenchmarkFormat::CSV;
+		}
+		else {
+			throw invalid_argument("unknown benchmark option "s + string(arg));
+		}
+	}
+	return options;
+}
+
+vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options) {
+	SyntheticCorpus corpus(options.corpus);
+	const vector<RawDocument> documents = corpus.GetDocuments();
+	const vector<string> queries = corpus.GenerateQueries(options.query_count);
+	const auto predicate = [](int, DocumentStatus, int rating) {
+		return rating > 0;
+	};
+
+	vector<BenchmarkResult> results;
+	SearchServer search_server("and with"s);
+	results.push_back(Measure("AddDocument", documents.size(), documents.size(), [&](size_t i) {
+		const RawDocument& document = documents[i];
+		search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+	}));
+
+	results.push_back(Measure("FindTopDocuments/seq/status", queries.size(), queries.size(), [&](size_t i) {
+		search_server.FindTopDocuments(execution::seq, queries[i], DocumentStatus::ACTUAL);
+	}));
+	results.push_back(Measure("FindTopDocuments/par/status", queries.size(), queries.size(), [&](size_t i) {
+		search_server.FindTopDocuments(execution::par, queries[i], DocumentStatus::ACTUAL);
+	}));
+	results.push_back(Measure("FindTopDocuments/seq/predicate", queries.size(), queries.size(), [&](size_t i) {
+		search_server.FindTopDocuments(execution::seq, queries[i], predicate);
+	}));
+	results.push_back(Measure("FindTopDocuments/par/predicate", queries.size(), queries.size(), [&](size_t i) {
+		search_server.FindTopDocuments(execution::par, queries[i], predicate);
+	}));
+
+	vector<PreparedQuery> prepared_queries;
+	prepared_queries.reserve(queries.size());
+	for (const string& query : queries) {
+		prepared_queries.push_back(search_server.PrepareQuery(query));
+	}
+	results.push_back(Measure("FindTopDocuments/seq/prepared", prepared_queries.size(), prepared_queries.size(), [&](size_t i) {
+		search_server.FindTopDocuments(execution::seq, prepared_queries[i], DocumentStatus::ACTUAL);
+	}));
+
+	const size_t document_count = documents.size();
+	results.push_back(Measure("MatchDocument", document_count == 0 ? 0 : queries.size(), queries.size(), [&](size_t i) {
+		search_server.MatchDocument(queries[i], documents[i % document_count].id);
+	}));
+
+	const size_t batch_match_count = min(queries.size(), MATCH_DOCUMENTS_QUERY_COUNT);
+	results.push_back(Measure("MatchDocuments/par", batch_match_count, batch_match_count * document_count, [&](size_t i) {
+		search_server.MatchDocuments(execution::par, queries[i]);
+	}));
+
+	const size_t batch_count = (queries.size() + PROCESS_QUERIES_BATCH_SIZE - 1) / PROCESS_QUERIES_BATCH_SIZE;
+	vector<vector<string>> batches(batch_count);
+	for (size_t i = 0; i < queries.size(); ++i) {
+		batches[i / PROCESS_QUERIES_BATCH_SIZE].push_back(queries[i]);
+	}
+	results.push_back(Measure("ProcessQueries", batches.size(), queries.size(), [&](size_t i) {
+		ProcessQueries(search_server, batches[i]);
+	}));
+
+	const size_t remove_count = min(options.remove_count, document_count);
+	results.push_back(Measure("RemoveDocument", remove_count, remove_count, [&](size_t i) {
+		search_server.RemoveDocument(documents[i].id);
+	}));
+
+	results.push_back(Measure("RemoveDuplicates", 1, static_cast<size_t>(search_server.GetDocumentCount()), [&](size_t) {
+		RemoveDuplicates(search_server, false);
+	}));
+
+	return results;
+}
+
+void PrintBenchmarkResults(ostream& out, const BenchmarkOptions& options, const vector<BenchmarkResult>& results) {
+	if (options.format == BenchmarkFormat::CSV) {
+		out << "name,call_count,operation_count,total_ns,operations_per_second,p50_ns,p99_ns,p999_ns,max_ns\n"s;
+		for (const BenchmarkResult& result : results) {
+			out << result.name << ',' << result.call_count << ',' << result.operation_count << ',' << result.total_ns << ','
+				<< result.operations_per_second << ',' << result.p50_ns << ',' << result.p99_ns << ',' << result.p999_ns << ','
+				<< result.max_ns << '\n';
+		}
+		return;
+	}
+
+	const SyntheticCorpusOptions& corpus = options.corpus;
+	out << "{\n  \"corpus\": {\"documents\": "s << corpus.document_count << ", \"vocabulary\": "s << corpus.vocabulary_size
+		<< ", \"document_words\": "s << corpus.words_per_document << ", \"query_words\": "s << corpus.query_word_count
+		<< ", \"zipf\": "s << corpus.zipf_exponent << ", \"queries\": "s << options.query_count
+		<< ", \"removes\": "s << options.remove_count << ", \"threads\": "s << options.thread_count << ", \"seed\": "s << corpus.seed << "},\n  \"results\": ["s;
+	bool is_first = true;
+	for (const BenchmarkResult& result : results) {
+		out << (is_first ? "\n"s : ",\n"s);
+		is_first = false;
+		// Names are fixed identifiers, so they need no escaping
+		out << "    {\"name\": \""s << result.name << "\", \"call_count\": "s << result.call_count
+			<< ", \"operation_count\": "s << result.operation_count << ", \"total_ns\": "s << result.total_ns
+			<< ", \"operations_per_second\": "s << result.operations_per_second << ", \"p50_ns\": "s << result.p50_ns
+			<< ", \"p99_ns\": "s << result.p99_ns << ", \"p999_ns\": "s << result.p999_ns << ", \"max_ns\": "s << result.max_ns << '}';
+	}
+	out << "\n  ]\n}\n"s;
+}
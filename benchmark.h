@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "synthetic_corpus.h"
+
+enum class BenchmarkFormat {
+	JSON,
+	CSV
+};
+
+struct BenchmarkOptions {
+	SyntheticCorpusOptions corpus;
+	size_t query_count = 1000;
+	// Documents removed one by one in the RemoveDocument benchmark
+	size_t remove_count = 1000;
+	// Workers of the default thread pool used by the par overloads; 0 means hardware_concurrency
+	size_t thread_count = 0;
+	BenchmarkFormat format = BenchmarkFormat::JSON;
+};
+
+// Latencies are exact percentiles over the timed calls; batch operations such as
+// ProcessQueries count every item in operation_count but time whole calls
+struct BenchmarkResult {
+	std::string name;
+	size_t call_count = 0;
+	size_t operation_count = 0;
+	uint64_t total_ns = 0;
+	double operations_per_second = 0.0;
+	uint64_t p50_ns = 0;
+	uint64_t p99_ns = 0;
+	uint64_t p999_ns = 0;
+	uint64_t max_ns = 0;
+};
+
+// Parses "--name=value" arguments: documents, vocabulary, document-words, query-words,
+// zipf, queries, removes, threads, seed and format (json or csv). Throws invalid_argument
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string_view>& args);
+
+// Builds a server from a synthetic corpus and times AddDocument, FindTopDocuments
+// (seq and par, by status and by predicate, and with prepared queries), MatchDocument,
+// MatchDocuments, ProcessQueries, RemoveDocument and RemoveDuplicates, in this order
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options);
+
+void PrintBenchmarkResults(std::ostream& out, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results);
@@ -0,0 +1,133 @@
+#include "corpus_loader.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <execution>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string_view TakeField(string_view& line) {
+	const size_t tab = line.find('\t');
+	if (tab == line.npos) {
+		throw invalid_argument("corpus line has too few fields");
+	}
+	const string_view field = line.substr(0, tab);
+	line.remove_prefix(tab + 1);
+	return field;
+}
+
+int ParseNumber(string_view text) {
+	int value = 0;
+	const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+	if (error != errc() || end != text.data() + text.size()) {
+		throw invalid_argument("bad number in corpus line");
+	}
+	return value;
+}
+
+RawDocument ParseCorpusLine(string_view line) {
+	RawDocument document;
+	document.id = ParseNumber(TakeField(line));
+	const int status = ParseNumber(TakeField(line));
+	if (status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+		throw invalid_argument("bad document status in corpus line");
+	}
+	document.status = static_cast<DocumentStatus>(status);
+
+	string_view ratings = TakeField(line);
+	while (!ratings.empty()) {
+		const size_t space = min(ratings.find(' '), ratings.size());
+		if (space > 0) {
+			document.ratings.push_back(ParseNumber(ratings.substr(0, space)));
+		}
+		ratings.remove_prefix(min(space + 1, ratings.size()));
+	}
+	document.text = line;
+	return document;
+}
+
+// Moves pos past the end of the line it falls into
+size_t FindLineEnd(string_view data, size_t pos) {
+	if (pos == 0 || pos >= data.size()) {
+		return min(pos, data.size());
+	}
+	const size_t newline = data.find('\n', pos - 1);
+	return newline == data.npos ? data.size() : newline + 1;
+}
+
+}
+
+vector<RawDocument> ParseCorpus(string_view data) {
+	vector<RawDocument> documents;
+	while (!data.empty()) {
+		const size_t newline = min(data.find('\n'), data.size());
+		string_view line = data.substr(0, newline);
+		data.remove_prefix(min(newline + 1, data.size()));
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		if (!line.empty()) {
+			documents.push_back(ParseCorpusLine(line));
+		}
+	}
+	return documents;
+}
+
+size_t LoadCorpus(SearchServer& search_server, const string& path, size_t window_size) {
+	const MappedFile file(path);
+	const string_view data = file.GetData();
+	const size_t thread_count = ThreadPool::GetDefault().GetThreadCount() + 1;
+	window_size = max<size_t>(window_size, 1);
+
+	size_t document_count = 0;
+	for (size_t window_begin = 0; window_begin < data.size();) {
+		const size_t window_end = FindLineEnd(data, min(data.size(), window_begin + window_size));
+		const string_view window = data.substr(window_begin, window_end - window_begin);
+
+		struct Chunk {
+			string_view data;
+			vector<RawDocument> documents;
+			exception_ptr error;
+		};
+
+		vector<Chunk> chunks;
+		for (size_t i = 0, chunk_begin = 0; i < thread_count && chunk_begin < window.size(); ++i) {
+			const size_t chunk_end = FindLineEnd(window, window.size() * (i + 1) / thread_count);
+			if (chunk_end > chunk_begin) {
+				chunks.push_back({ window.substr(chunk_begin, chunk_end - chunk_begin), {}, nullptr });
+				chunk_begin = chunk_end;
+			}
+		}
+		ThreadPool::GetDefault().ParallelFor(chunks.size(), [&chunks](size_t chunk_index) {
+			Chunk& chunk = chunks[chunk_index];
+			try {
+				chunk.documents = ParseCorpus(chunk.data);
+			}
+			catch (...) {
+				chunk.error = current_exception();
+			}
+		});
+
+		vector<RawDocument> documents;
+		for (Chunk& chunk : chunks) {
+			if (chunk.error) {
+				rethrow_exception(chunk.error);
+			}
+			move(chunk.documents.begin(), chunk.documents.end(), back_inserter(documents));
+		}
+		search_server.AddDocuments(execution::par, documents);
+		document_count += documents.size();
+		window_begin = window_end;
+	}
+	return document_count;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Corpus files hold one document per line, fields separated by tabs:
+// id, status (the DocumentStatus number), space separated ratings and the text
+const size_t CORPUS_WINDOW_SIZE = 64 << 20;
+
+// Parses lines of a corpus; document texts point into data
+std::vector<RawDocument> ParseCorpus(std::string_view data);
+
+// Maps the file and adds it to the server window by window: every window is cut on line
+// boundaries into one chunk per thread, parsed in parallel and added with AddDocuments(par).
+// Returns the number of added documents
+size_t LoadCorpus(SearchServer& search_server, const std::string& path, size_t window_size = CORPUS_WINDOW_SIZE);
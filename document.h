@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 struct Document {
 
@@ -18,6 +20,20 @@ enum class DocumentStatus {
 	REMOVED
 };
 
+struct RawDocument {
+	int id = 0;
+	std::string_view text;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+	std::vector<int> ratings;
+};
+
+struct MatchedDocument {
+	int id = 0;
+	// Empty when the document has a minus word
+	std::vector<std::string_view> words;
+	DocumentStatus status = DocumentStatus::ACTUAL;
+};
+
 std::ostream& operator<< (std::ostream& os, const DocumentStatus& container);
 
 std::ostream& operator<< (std::ostream& out, const Document& doc);
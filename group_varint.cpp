@@ -0,0 +1,142 @@
+#include "group_varint.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define GROUP_VARINT_SSE2
+#include <emmintrin.h>
+#endif
+
+// The pshufb decoder is compiled for SSSE3 whatever the build flags are and picked at run
+// time, so default x86-64 builds use it on every CPU that has the instruction
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define GROUP_VARINT_SSSE3
+#include <tmmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	int GetByteLength(uint32_t value) {
+		if (value < (1u << 8)) return 1;
+		if (value < (1u << 16)) return 2;
+		if (value < (1u << 24)) return 3;
+		return 4;
+	}
+
+#ifdef GROUP_VARINT_SSSE3
+	struct ControlTable {
+		array<uint8_t, 256> lengths;
+		array<array<uint8_t, 16>, 256> shuffles;
+
+		ControlTable() {
+			for (int control = 0; control < 256; ++control) {
+				int byte = 0;
+				for (int i = 0; i < 4; ++i) {
+					const int length = ((control >> (2 * i)) & 3) + 1;
+					for (int j = 0; j < 4; ++j) {
+						// 0xFF makes pshufb write zero
+						shuffles[control][4 * i + j] = j < length ? static_cast<uint8_t>(byte + j) : 0xFF;
+					}
+					byte += length;
+				}
+				lengths[control] = static_cast<uint8_t>(byte);
+			}
+		}
+	};
+
+	const ControlTable& GetControlTable() {
+		static const ControlTable table;
+		return table;
+	}
+#endif
+}
+
+void EncodeGroupVarint(const uint32_t* values, size_t count, vector<uint8_t>& output) {
+	for (size_t group = 0; group < count; group += 4) {
+		const size_t control_pos = output.size();
+		output.push_back(0);
+		uint8_t control = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			const uint32_t value = group + i < count ? values[group + i] : 0;
+			const int length = GetByteLength(value);
+			control |= static_cast<uint8_t>((length - 1) << (2 * i));
+			for (int j = 0; j < length; ++j) {
+				output.push_back(static_cast<uint8_t>(value >> (8 * j)));
+			}
+		}
+		output[control_pos] = control;
+	}
+}
+
+namespace {
+	const uint8_t* DecodeGroupVarintScalar(const uint8_t* input, size_t count, uint32_t* output) {
+		for (size_t group = 0; group < count; group += 4) {
+			const uint8_t control = *input++;
+			for (int i = 0; i < 4; ++i) {
+				const int length = ((control >> (2 * i)) & 3) + 1;
+				uint32_t value = 0;
+				for (int j = 0; j < length; ++j) {
+					value |= static_cast<uint32_t>(input[j]) << (8 * j);
+				}
+				output[group + i] = value;
+				input += length;
+			}
+		}
+		return input;
+	}
+
+#ifdef GROUP_VARINT_SSSE3
+	__attribute__((target("ssse3")))
+	const uint8_t* DecodeGroupVarintSsse3(const uint8_t* input, size_t count, uint32_t* output) {
+		const ControlTable& table = GetControlTable();
+		for (size_t group = 0; group < count; group += 4) {
+			const uint8_t control = *input++;
+			const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+			const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.shuffles[control].data()));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + group), _mm_shuffle_epi8(data, shuffle));
+			input += table.lengths[control];
+		}
+		return input;
+	}
+#endif
+
+	using DecodeFunction = const uint8_t* (*)(const uint8_t*, size_t, uint32_t*);
+
+	DecodeFunction SelectDecoder() {
+#ifdef GROUP_VARINT_SSSE3
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("ssse3")) {
+			return DecodeGroupVarintSsse3;
+		}
+#endif
+		return DecodeGroupVarintScalar;
+	}
+}
+
+const uint8_t* DecodeGroupVarint(const uint8_t* input, size_t count, uint32_t* output) {
+	static const DecodeFunction decode = SelectDecoder();
+	return decode(input, count, output);
+}
+
+void DecodeDeltas(uint32_t* values, size_t count, uint32_t base) {
+	size_t i = 0;
+#ifdef GROUP_VARINT_SSE2
+	__m128i previous = _mm_set1_epi32(static_cast<int>(base));
+	for (; i + 4 <= count; i += 4) {
+		__m128i deltas = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+		deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+		deltas = _mm_add_epi32(deltas, previous);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), deltas);
+		previous = _mm_shuffle_epi32(deltas, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	base = static_cast<uint32_t>(_mm_cvtsi128_si32(previous));
+#endif
+	for (; i < count; ++i) {
+		base += values[i];
+		values[i] = base;
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Group varint coding: every 4 values share a control byte holding their byte lengths.
+// Decoding reads up to GROUP_VARINT_PADDING bytes past the last group, so encoded
+// buffers must keep that many readable bytes after the data.
+const size_t GROUP_VARINT_PADDING = 16;
+
+void EncodeGroupVarint(const uint32_t* values, size_t count, std::vector<uint8_t>& output);
+
+// Decodes count values rounded up to a multiple of 4; returns the position after the data
+const uint8_t* DecodeGroupVarint(const uint8_t* input, size_t count, uint32_t* output);
+
+// Turns deltas into absolute values starting from base
+void DecodeDeltas(uint32_t* values, size_t count, uint32_t base);
@@ -0,0 +1,45 @@
+#include "index_file.h"
+
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+
+using namespace std;
+
+IndexWriter::IndexWriter(ostream& out)
+	: out_(out) {}
+
+void IndexWriter::WriteString(string_view text) {
+	Write(static_cast<uint32_t>(text.size()));
+	out_.write(text.data(), text.size());
+}
+
+IndexReader::IndexReader(string_view data)
+	: data_(data) {}
+
+string_view IndexReader::ReadString() {
+	const uint32_t size = Read<uint32_t>();
+	return { Take(size), size };
+}
+
+size_t IndexReader::ReadCount(size_t min_item_size) {
+	const uint64_t count = Read<uint64_t>();
+	if (count > (data_.size() - pos_) / min_item_size) {
+		throw runtime_error("index file is truncated");
+	}
+	return static_cast<size_t>(count);
+}
+
+bool IndexReader::IsEnd() const {
+	return pos_ == data_.size();
+}
+
+const char* IndexReader::Take(size_t size) {
+	if (size > data_.size() - pos_) {
+		throw runtime_error("index file is truncated");
+	}
+	const char* data = data_.data() + pos_;
+	pos_ += size;
+	return data;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Index files are a header followed by sections of raw arrays in native byte order
+const uint32_t INDEX_FILE_MAGIC = 0x58444953; // "SIDX"
+const uint32_t INDEX_FILE_VERSION = 1;
+
+class IndexWriter {
+public:
+	explicit IndexWriter(std::ostream& out);
+
+	template <typename T>
+	void Write(const T& value);
+
+	template <typename T>
+	void WriteArray(const std::vector<T>& values);
+
+	void WriteString(std::string_view text);
+
+private:
+	std::ostream& out_;
+};
+
+// Reads from a memory region, e.g. a MappedFile; arrays are copied out in one piece
+class IndexReader {
+public:
+	explicit IndexReader(std::string_view data);
+
+	template <typename T>
+	T Read();
+
+	template <typename T>
+	void ReadArray(std::vector<T>& values);
+
+	// Points into the underlying data
+	std::string_view ReadString();
+
+	// Reads an item count and checks that the rest of the data can hold that many
+	// items of at least min_item_size bytes each
+	size_t ReadCount(size_t min_item_size);
+
+	bool IsEnd() const;
+
+private:
+	std::string_view data_;
+	size_t pos_ = 0;
+
+	const char* Take(size_t size);
+};
+
+template <typename T>
+void IndexWriter::Write(const T& value) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void IndexWriter::WriteArray(const std::vector<T>& values) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	Write(static_cast<uint64_t>(values.size()));
+	out_.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+T IndexReader::Read() {
+	static_assert(std::is_trivially_copyable_v<T>);
+	T value;
+	std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+	return value;
+}
+
+template <typename T>
+void IndexReader::ReadArray(std::vector<T>& values) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	const uint64_t size = Read<uint64_t>();
+	if (size > (data_.size() - pos_) / sizeof(T)) {
+		throw std::runtime_error("index file is truncated");
+	}
+	values.resize(size);
+	if (size > 0) {
+		std::memcpy(values.data(), Take(size * sizeof(T)), size * sizeof(T));
+	}
+}
@@ -0,0 +1,225 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	constexpr int SUB_BUCKET_BITS = 4;
+	constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+	constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+	constexpr size_t STAGE_COUNT = static_cast<size_t>(LatencyStage::COUNT);
+
+	int GetHighestBit(uint64_t value) {
+#if defined(__GNUC__)
+		return 63 - __builtin_clzll(value);
+#else
+		int bit = 0;
+		while (value >>= 1) {
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	size_t GetBucket(uint64_t value) {
+		if (value < SUB_BUCKET_COUNT) {
+			return static_cast<size_t>(value);
+		}
+		const int shift = GetHighestBit(value) - SUB_BUCKET_BITS;
+		return static_cast<size_t>((shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT));
+	}
+
+	uint64_t GetBucketUpperBound(size_t bucket) {
+		if (bucket < SUB_BUCKET_COUNT) {
+			return bucket;
+		}
+		const int shift = static_cast<int>(bucket / SUB_BUCKET_COUNT) - 1;
+		const uint64_t lower = (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+		return lower + ((uint64_t{ 1 } << shift) - 1);
+	}
+
+	// Written only by the owning thread, read by summaries from any thread
+	struct ThreadHistograms {
+		array<array<atomic<uint64_t>, BUCKET_COUNT>, STAGE_COUNT> counts = {};
+		array<atomic<uint64_t>, STAGE_COUNT> max_ns = {};
+	};
+
+	void Increase(atomic<uint64_t>& counter, uint64_t delta) {
+		counter.store(counter.load(memory_order_relaxed) + delta, memory_order_relaxed);
+	}
+
+	atomic<bool> is_enabled{ false };
+	mutex registry_mutex;
+	// Counts of exited threads, written only under registry_mutex
+	ThreadHistograms retired_histograms;
+	vector<ThreadHistograms*> registry = { &retired_histograms };
+
+	// Registers the histograms of a thread and retires them when the thread exits
+	class ThreadHistogramsOwner {
+	public:
+		ThreadHistogramsOwner()
+			: histograms_(make_unique<ThreadHistograms>()) {
+			lock_guard guard(registry_mutex);
+			registry.push_back(histograms_.get());
+		}
+
+		ThreadHistogramsOwner(const ThreadHistogramsOwner&) = delete;
+		ThreadHistogramsOwner& operator=(const ThreadHistogramsOwner&) = delete;
+
+		~ThreadHistogramsOwner() {
+			lock_guard guard(registry_mutex);
+			for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+				for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+					Increase(retired_histograms.counts[stage][bucket], histograms_->counts[stage][bucket].load(memory_order_relaxed));
+				}
+				const uint64_t max_ns = histograms_->max_ns[stage].load(memory_order_relaxed);
+				if (max_ns > retired_histograms.max_ns[stage].load(memory_order_relaxed)) {
+					retired_histograms.max_ns[stage].store(max_ns, memory_order_relaxed);
+				}
+			}
+			registry.erase(find(registry.begin(), registry.end(), histograms_.get()));
+		}
+
+		ThreadHistograms& Get() const {
+			return *histograms_;
+		}
+
+	private:
+		unique_ptr<ThreadHistograms> histograms_;
+	};
+
+	ThreadHistograms& GetThreadHistograms() {
+		thread_local const ThreadHistogramsOwner owner;
+		return owner.Get();
+	}
+}
+
+namespace latency {
+	void SetEnabled(bool enabled) {
+		is_enabled.store(enabled, memory_order_relaxed);
+	}
+
+	bool IsEnabled() {
+		return is_enabled.load(memory_order_relaxed);
+	}
+
+	void Record(LatencyStage stage, uint64_t duration_ns) {
+		ThreadHistograms& histograms = GetThreadHistograms();
+		const size_t index = static_cast<size_t>(stage);
+		Increase(histograms.counts[index][GetBucket(duration_ns)], 1);
+		if (duration_ns > histograms.max_ns[index].load(memory_order_relaxed)) {
+			histograms.max_ns[index].store(duration_ns, memory_order_relaxed);
+		}
+	}
+
+	LatencySummary GetSummary(LatencyStage stage) {
+		const size_t index = static_cast<size_t>(stage);
+		vector<uint64_t> counts(BUCKET_COUNT);
+		LatencySummary summary;
+		{
+			lock_guard guard(registry_mutex);
+			for (const auto& histograms : registry) {
+				for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+					counts[bucket] += histograms->counts[index][bucket].load(memory_order_relaxed);
+				}
+				summary.max_ns = max(summary.max_ns, histograms->max_ns[index].load(memory_order_relaxed));
+			}
+		}
+		for (const uint64_t count : counts) {
+			summary.count += count;
+		}
+		if (summary.count == 0) {
+			return summary;
+		}
+
+		const auto get_percentile = [&](uint64_t per_mille) {
+			// Rank of the sample the percentile falls on, counted from 1
+			const uint64_t rank = max<uint64_t>(1, (summary.count * per_mille + 999) / 1000);
+			uint64_t seen = 0;
+			for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+				seen += counts[bucket];
+				if (seen >= rank) {
+					return min(GetBucketUpperBound(bucket), summary.max_ns);
+				}
+			}
+			return summary.max_ns;
+		};
+		summary.p50_ns = get_percentile(500);
+		summary.p99_ns = get_percentile(990);
+		summary.p999_ns = get_percentile(999);
+		return summary;
+	}
+
+	void Reset() {
+		lock_guard guard(registry_mutex);
+		for (const auto& histograms : registry) {
+			for (auto& stage_counts : histograms->counts) {
+				for (auto& count : stage_counts) {
+					count.store(0, memory_order_relaxed);
+				}
+			}
+			for (auto& max_ns : histograms->max_ns) {
+				max_ns.store(0, memory_order_relaxed);
+			}
+		}
+	}
+}
+
+void StageLatencies::Add(LatencyStage stage, uint64_t duration_ns) {
+	const size_t index = static_cast<size_t>(stage);
+	durations_ns_[index] += duration_ns;
+	is_added_[index] = true;
+}
+
+void StageLatencies::MergeParallel(const StageLatencies& other) {
+	for (size_t index = 0; index < STAGE_COUNT; ++index) {
+		durations_ns_[index] = max(durations_ns_[index], other.durations_ns_[index]);
+		is_added_[index] = is_added_[index] || other.is_added_[index];
+	}
+}
+
+void StageLatencies::Record() const {
+	for (size_t index = 0; index < STAGE_COUNT; ++index) {
+		if (is_added_[index]) {
+			latency::Record(static_cast<LatencyStage>(index), durations_ns_[index]);
+		}
+	}
+}
+
+LatencyTimer::LatencyTimer()
+	: LatencyTimer(nullptr) {}
+
+LatencyTimer::LatencyTimer(StageLatencies* latencies)
+	: is_enabled_(latency::IsEnabled())
+	, latencies_(latencies)
+	, start_(is_enabled_ ? Clock::now() : Clock::time_point()) {}
+
+void LatencyTimer::Lap(LatencyStage stage) {
+	if (!is_enabled_) {
+		return;
+	}
+	const auto now = Clock::now();
+	const auto duration_ns = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(now - start_).count());
+	if (latencies_) {
+		latencies_->Add(stage, duration_ns);
+	}
+	else {
+		latency::Record(stage, duration_ns);
+	}
+	start_ = now;
+}
+
+ScopedLatency::ScopedLatency(LatencyStage stage)
+	: stage_(stage) {}
+
+ScopedLatency::~ScopedLatency() {
+	timer_.Lap(stage_);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+enum class LatencyStage {
+	// FindTopDocuments
+	PARSE,
+	MINUS_WORDS,
+	POSTINGS,
+	// Predicate checks and top-K heap insertion of the scored documents
+	FILTER,
+	// Final ordering of the top documents
+	TOP_K,
+	ADD_DOCUMENT,
+	REMOVE_DOCUMENT,
+	MATCH_DOCUMENT,
+	COUNT
+};
+
+struct LatencySummary {
+	uint64_t count = 0;
+	uint64_t p50_ns = 0;
+	uint64_t p99_ns = 0;
+	uint64_t p999_ns = 0;
+	uint64_t max_ns = 0;
+};
+
+// Log-linear histograms in nanoseconds: values below 16 are exact, larger ones fall into
+// 16 buckets per power of two, so percentiles are off by at most 1/16. Every thread writes
+// its own histograms without locks or atomic read-modify-writes; summaries merge them.
+// When a thread exits, its counts are folded into shared histograms and its own are freed.
+// Tracking is off until enabled, and then a disabled timer costs one relaxed load.
+namespace latency {
+	void SetEnabled(bool enabled);
+	bool IsEnabled();
+
+	void Record(LatencyStage stage, uint64_t duration_ns);
+
+	LatencySummary GetSummary(LatencyStage stage);
+
+	// Meant for idle periods: counts recorded concurrently may survive the reset
+	void Reset();
+}
+
+// Stage durations collected instead of recorded, for operations that run their parts in
+// parallel: the parts are merged first, so that every stage is recorded once
+class StageLatencies {
+public:
+	void Add(LatencyStage stage, uint64_t duration_ns);
+
+	// Keeps the longer duration of every stage, as parts running side by side take
+	// as long as the slowest of them
+	void MergeParallel(const StageLatencies& other);
+
+	// Records every stage that was added
+	void Record() const;
+
+private:
+	static constexpr size_t STAGE_COUNT = static_cast<size_t>(LatencyStage::COUNT);
+
+	std::array<uint64_t, STAGE_COUNT> durations_ns_ = {};
+	std::array<bool, STAGE_COUNT> is_added_ = {};
+};
+
+// Measures consecutive stages of one operation: every Lap records the time since
+// construction or the previous Lap
+class LatencyTimer {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	LatencyTimer();
+	// Laps go to latencies rather than to the histograms
+	explicit LatencyTimer(StageLatencies* latencies);
+
+	void Lap(LatencyStage stage);
+
+private:
+	bool is_enabled_;
+	StageLatencies* latencies_;
+	Clock::time_point start_;
+};
+
+// Records the lifetime of the guard as one stage
+class ScopedLatency {
+public:
+	explicit ScopedLatency(LatencyStage stage);
+	ScopedLatency(const ScopedLatency&) = delete;
+	ScopedLatency& operator=(const ScopedLatency&) = delete;
+	~ScopedLatency();
+
+private:
+	LatencyStage stage_;
+	LatencyTimer timer_;
+};
@@ -1,34 +0,0 @@
-#pragma once
-
-#include <chrono>
-#include <iostream>
-
-#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
-#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
-#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
-#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
-#define LOG_DURATION_STREAM(x, y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
-
-
-class LogDuration {
-public:
-	using Clock = std::chrono::steady_clock;
-
-	LogDuration(const std::string& id, std::ostream& c = std::cerr)
-		: id_(id)
-		, stream_(c) {}
-
-	~LogDuration() {
-		using namespace std::chrono;
-		using namespace std::literals;
-
-		const auto end_time = Clock::now();
-		const auto dur = end_time - start_time_;
-		stream_ << id_ << ": "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
-	}
-
-private:
-	const std::string id_;
-	std::ostream& stream_;
-	const Clock::time_point start_time_ = Clock::now();
-};
@@ -1,18 +1,37 @@
-﻿#include "process_queries.h"
+﻿#include "benchmark.h"
+#include "process_queries.h"
 #include "search_server.h"
 #include "string_processing.h"
 #include "test_example_functions.h"
+#include "thread_pool.h"
 
 #include <execution>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
 
 
 
-int main() {
+int main(int argc, char* argv[]) {
+	if (argc > 1 && argv[1] == "--benchmark"sv) {
+		try {
+			const BenchmarkOptions options = ParseBenchmarkOptions(vector<string_view>(argv + 2, argv + argc));
+			if (options.thread_count > 0) {
+				ThreadPool::SetDefaultThreadCount(options.thread_count);
+			}
+			PrintBenchmarkResults(cout, options, RunBenchmarks(options));
+		}
+		catch (const invalid_argument& e) {
+			cerr << e.what() << endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	TestSearchServer();
 	SearchServer search_server("and with"s);
 
@@ -0,0 +1,64 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw runtime_error("can't open file " + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		throw runtime_error("can't read file " + path);
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	if (size_ > 0) {
+		data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data_ == MAP_FAILED) {
+			data_ = nullptr;
+			close(fd);
+			throw runtime_error("can't map file " + path);
+		}
+		madvise(data_, size_, MADV_SEQUENTIAL);
+	}
+	close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: data_(exchange(other.data_, nullptr))
+	, size_(exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		Unmap();
+		data_ = exchange(other.data_, nullptr);
+		size_ = exchange(other.size_, 0);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	Unmap();
+}
+
+string_view MappedFile::GetData() const {
+	return { static_cast<const char*>(data_), size_ };
+}
+
+void MappedFile::Unmap() {
+	if (data_ != nullptr) {
+		munmap(data_, size_);
+		data_ = nullptr;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	std::string_view GetData() const;
+
+private:
+	void* data_ = nullptr;
+	size_t size_ = 0;
+
+	void Unmap();
+};
@@ -0,0 +1,249 @@
+#include "posting_list.h"
+#include "group_varint.h"
+#include "index_file.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+	: postings_(&postings) {}
+
+bool PostingList::Cursor::IsEnd() const {
+	return pos_ >= size_;
+}
+
+int PostingList::Cursor::GetDocumentId() const {
+	return static_cast<int>(document_ids_[pos_]);
+}
+
+uint32_t PostingList::Cursor::GetTermCount() const {
+	return term_counts_[pos_];
+}
+
+void PostingList::Cursor::Next() {
+	if (!is_started_) {
+		is_started_ = true;
+		LoadSegment(0);
+		return;
+	}
+	if (++pos_ == size_) {
+		LoadSegment(segment_ + 1);
+	}
+}
+
+void PostingList::Cursor::NextGeq(int document_id) {
+	if (!is_started_) {
+		is_started_ = true;
+		LoadSegment(postings_->FindSegment(0, document_id));
+	}
+	if (IsEnd() || GetDocumentId() >= document_id) {
+		return;
+	}
+	if (postings_->GetSegmentLastDocumentId(segment_) < document_id) {
+		LoadSegment(postings_->FindSegment(segment_ + 1, document_id));
+		if (IsEnd()) {
+			return;
+		}
+	}
+	pos_ = lower_bound(document_ids_.begin() + pos_, document_ids_.begin() + size_, static_cast<uint32_t>(document_id))
+		- document_ids_.begin();
+}
+
+double PostingList::Cursor::GetBlockMaxTermFreq(int document_id) {
+	const size_t segment_count = postings_->GetSegmentCount();
+	while (max_segment_ < segment_count && postings_->GetSegmentLastDocumentId(max_segment_) < document_id) {
+		++max_segment_;
+	}
+	return max_segment_ < segment_count ? postings_->GetSegmentMaxTermFreq(max_segment_) : 0.0;
+}
+
+void PostingList::Cursor::LoadSegment(size_t segment) {
+	const size_t segment_count = postings_->GetSegmentCount();
+	segment_ = segment;
+	pos_ = 0;
+	size_ = segment_ < segment_count
+		? postings_->DecodeSegment(segment_, document_ids_.data(), term_counts_.data())
+		: 0;
+}
+
+void PostingList::Add(int document_id, uint32_t term_count, double term_freq) {
+	tail_document_ids_.push_back(document_id);
+	tail_term_counts_.push_back(term_count);
+	tail_max_term_freq_ = max(tail_max_term_freq_, term_freq);
+	max_term_freq_ = max(max_term_freq_, term_freq);
+	++size_;
+	if (tail_document_ids_.size() == BLOCK_SIZE) {
+		FlushTail();
+	}
+}
+
+bool PostingList::Contains(int document_id) const {
+	Cursor cursor(*this);
+	cursor.NextGeq(document_id);
+	return !cursor.IsEnd() && cursor.GetDocumentId() == document_id;
+}
+
+size_t PostingList::size() const {
+	return size_;
+}
+
+bool PostingList::empty() const {
+	return size_ == 0;
+}
+
+double PostingList::GetMaxTermFreq() const {
+	return max_term_freq_;
+}
+
+size_t PostingList::GetMemoryUsage() const {
+	return blocks_.capacity() * sizeof(Block)
+		+ data_.capacity()
+		+ tail_document_ids_.capacity() * sizeof(int)
+		+ tail_term_counts_.capacity() * sizeof(uint32_t);
+}
+
+void PostingList::Save(IndexWriter& out) const {
+	out.WriteArray(blocks_);
+	out.WriteArray(data_);
+	out.WriteArray(tail_document_ids_);
+	out.WriteArray(tail_term_counts_);
+	out.Write(tail_max_term_freq_);
+	out.Write(max_term_freq_);
+	out.Write(static_cast<uint64_t>(size_));
+}
+
+void PostingList::Load(IndexReader& in) {
+	in.ReadArray(blocks_);
+	in.ReadArray(data_);
+	in.ReadArray(tail_document_ids_);
+	in.ReadArray(tail_term_counts_);
+	tail_max_term_freq_ = in.Read<double>();
+	max_term_freq_ = in.Read<double>();
+	size_ = static_cast<size_t>(in.Read<uint64_t>());
+}
+
+void PostingList::Validate(int document_count) const {
+	const auto check = [](bool condition) {
+		if (!condition) {
+			throw runtime_error("posting list is corrupted");
+		}
+	};
+	check(blocks_.empty() || data_.size() >= GROUP_VARINT_PADDING);
+	check(tail_document_ids_.size() == tail_term_counts_.size() && tail_document_ids_.size() < BLOCK_SIZE);
+
+	size_t total_size = tail_document_ids_.size();
+	int64_t previous_id = -1;
+	array<uint32_t, BLOCK_SIZE> document_ids;
+	array<uint32_t, BLOCK_SIZE> term_counts;
+	for (size_t segment = 0; segment < blocks_.size(); ++segment) {
+		const Block& block = blocks_[segment];
+		check(block.size > 0 && block.size <= BLOCK_SIZE);
+		const size_t end = segment + 1 < blocks_.size() ? blocks_[segment + 1].offset : data_.size() - GROUP_VARINT_PADDING;
+		check(block.offset <= end && end <= data_.size() - GROUP_VARINT_PADDING);
+		// Walk the control bytes of the ids and the counts, so decoding stays inside the block
+		size_t pos = block.offset;
+		for (size_t group = 0; group < 2 * ((block.size + 3) / 4); ++group) {
+			check(pos < end);
+			const uint8_t control = data_[pos];
+			pos += 1;
+			for (int i = 0; i < 4; ++i) {
+				pos += ((control >> (2 * i)) & 3) + 1;
+			}
+		}
+		check(pos <= end);
+
+		const size_t size = DecodeSegment(segment, document_ids.data(), term_counts.data());
+		check(static_cast<int>(document_ids[0]) == block.first_document_id && static_cast<int>(document_ids[size - 1]) == block.last_document_id);
+		for (size_t i = 0; i < size; ++i) {
+			check(document_ids[i] > previous_id && document_ids[i] < static_cast<uint32_t>(document_count));
+			previous_id = document_ids[i];
+		}
+		total_size += size;
+	}
+	for (const int document_id : tail_document_ids_) {
+		check(document_id > previous_id && document_id < document_count);
+		previous_id = document_id;
+	}
+	check(size_ == total_size);
+}
+
+size_t PostingList::GetSegmentCount() const {
+	return blocks_.size() + (tail_document_ids_.empty() ? 0 : 1);
+}
+
+size_t PostingList::FindSegment(size_t first_segment, int document_id) const {
+	const auto it = lower_bound(blocks_.begin() + min(first_segment, blocks_.size()), blocks_.end(), document_id,
+		[](const Block& block, int id) {
+			return block.last_document_id < id;
+		});
+	if (it != blocks_.end()) {
+		return it - blocks_.begin();
+	}
+	if (!tail_document_ids_.empty() && tail_document_ids_.back() >= document_id) {
+		return blocks_.size();
+	}
+	return GetSegmentCount();
+}
+
+int PostingList::GetSegmentLastDocumentId(size_t segment) const {
+	return segment < blocks_.size() ? blocks_[segment].last_document_id : tail_document_ids_.back();
+}
+
+double PostingList::GetSegmentMaxTermFreq(size_t segment) const {
+	return segment < blocks_.size() ? blocks_[segment].max_term_freq : tail_max_term_freq_;
+}
+
+size_t PostingList::DecodeSegment(size_t segment, uint32_t* document_ids, uint32_t* term_counts) const {
+	if (segment == blocks_.size()) {
+		copy(tail_document_ids_.begin(), tail_document_ids_.end(), document_ids);
+		copy(tail_term_counts_.begin(), tail_term_counts_.end(), term_counts);
+		return tail_document_ids_.size();
+	}
+	const Block& block = blocks_[segment];
+	const uint8_t* input = data_.data() + block.offset;
+	input = DecodeGroupVarint(input, block.size, document_ids);
+	DecodeDeltas(document_ids, block.size, static_cast<uint32_t>(block.first_document_id));
+	DecodeGroupVarint(input, block.size, term_counts);
+	return block.size;
+}
+
+vector<uint8_t> PostingList::EncodeBlock(const uint32_t* document_ids, const uint32_t* term_counts, size_t size) const {
+	array<uint32_t, BLOCK_SIZE> deltas;
+	uint32_t previous = size > 0 ? document_ids[0] : 0;
+	for (size_t i = 0; i < size; ++i) {
+		deltas[i] = document_ids[i] - previous;
+		previous = document_ids[i];
+	}
+	vector<uint8_t> encoded;
+	EncodeGroupVarint(deltas.data(), size, encoded);
+	EncodeGroupVarint(term_counts, size, encoded);
+	return encoded;
+}
+
+void PostingList::FlushTail() {
+	array<uint32_t, BLOCK_SIZE> document_ids;
+	copy(tail_document_ids_.begin(), tail_document_ids_.end(), document_ids.begin());
+	const vector<uint8_t> encoded = EncodeBlock(document_ids.data(), tail_term_counts_.data(), tail_document_ids_.size());
+
+	if (!data_.empty()) {
+		data_.resize(data_.size() - GROUP_VARINT_PADDING);
+	}
+	blocks_.push_back({
+		tail_document_ids_.front(),
+		tail_document_ids_.back(),
+		static_cast<uint32_t>(data_.size()),
+		static_cast<uint32_t>(tail_document_ids_.size()),
+		tail_max_term_freq_
+	});
+	data_.insert(data_.end(), encoded.begin(), encoded.end());
+	data_.resize(data_.size() + GROUP_VARINT_PADDING);
+
+	tail_document_ids_.clear();
+	tail_term_counts_.clear();
+	tail_max_term_freq_ = 0.0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class IndexReader;
+class IndexWriter;
+
+// Compressed postings of one term: document ids (delta coded) and term counts are
+// group varint encoded in blocks of BLOCK_SIZE; the newest postings stay in a plain tail.
+// Document ids must be added in increasing order.
+class PostingList {
+public:
+	static constexpr size_t BLOCK_SIZE = 128;
+
+	// A new cursor stands before the first posting and decodes nothing until Next or
+	// NextGeq, so a lookup decodes only the block it lands in
+	class Cursor {
+	public:
+		explicit Cursor(const PostingList& postings);
+
+		bool IsEnd() const;
+		int GetDocumentId() const;
+		uint32_t GetTermCount() const;
+
+		void Next();
+		void NextGeq(int document_id);
+
+		double GetBlockMaxTermFreq(int document_id);
+
+	private:
+		const PostingList* postings_;
+		size_t segment_ = 0;
+		size_t pos_ = 0;
+		size_t size_ = 0;
+		size_t max_segment_ = 0;
+		bool is_started_ = false;
+		std::array<uint32_t, BLOCK_SIZE> document_ids_;
+		std::array<uint32_t, BLOCK_SIZE> term_counts_;
+
+		void LoadSegment(size_t segment);
+	};
+
+	// term_freq only feeds the block upper bounds used for pruning
+	void Add(int document_id, uint32_t term_count, double term_freq);
+	bool Contains(int document_id) const;
+
+	size_t size() const;
+	bool empty() const;
+
+	double GetMaxTermFreq() const;
+
+	size_t GetMemoryUsage() const;
+
+	void Save(IndexWriter& out) const;
+	void Load(IndexReader& in);
+	// Checks loaded postings: block bounds within the data, increasing ids below
+	// document_count and the stored size. Throws runtime_error
+	void Validate(int document_count) const;
+
+private:
+	struct Block {
+		int first_document_id;
+		int last_document_id;
+		uint32_t offset;
+		uint32_t size;
+		// Upper bound: postings of removed documents count until the list is rebuilt
+		double max_term_freq;
+	};
+
+	std::vector<Block> blocks_;
+	std::vector<uint8_t> data_;
+	std::vector<int> tail_document_ids_;
+	std::vector<uint32_t> tail_term_counts_;
+	double tail_max_term_freq_ = 0.0;
+	double max_term_freq_ = 0.0;
+	size_t size_ = 0;
+
+	size_t GetSegmentCount() const;
+	size_t FindSegment(size_t first_segment, int document_id) const;
+	int GetSegmentLastDocumentId(size_t segment) const;
+	double GetSegmentMaxTermFreq(size_t segment) const;
+
+	size_t DecodeSegment(size_t segment, uint32_t* document_ids, uint32_t* term_counts) const;
+	std::vector<uint8_t> EncodeBlock(const uint32_t* document_ids, const uint32_t* term_counts, size_t size) const;
+	void FlushTail();
+};
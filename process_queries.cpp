@@ -1,28 +1,45 @@
 #include "process_queries.h"
 #include "document.h"
 #include "search_server.h"
+#include "thread_pool.h"
 
 #include <algorithm>
-#include <execution>
 
 using namespace std;
 
 vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<string>& queries) {
 	vector<vector<Document>> documents_lists(queries.size());
-	transform(
-		execution::par,
-		queries.begin(), queries.end(),
-		documents_lists.begin(),
-		[&search_server](const string& query) {
-			return search_server.FindTopDocuments(query);
+	ThreadPool::GetDefault().ParallelFor(queries.size(), [&](size_t i) {
+		documents_lists[i] = search_server.FindTopDocuments(queries[i]);
 	});
 	return documents_lists;
 }
 
-vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries) {
+vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const vector<PreparedQuery>& queries) {
+	vector<vector<Document>> documents_lists(queries.size());
+	ThreadPool::GetDefault().ParallelFor(queries.size(), [&](size_t i) {
+		documents_lists[i] = search_server.FindTopDocuments(queries[i]);
+	});
+	return documents_lists;
+}
+
+namespace {
+
+template <typename Query>
+vector<Document> JoinQueryResults(const SearchServer& search_server, const vector<Query>& queries) {
 	vector<Document> documents;
 	for (const auto& local_documents : ProcessQueries(search_server, queries)) {
 		documents.insert(documents.end(), local_documents.begin(), local_documents.end());
 	}
 	return documents;
 }
+
+}
+
+vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries) {
+	return JoinQueryResults(search_server, queries);
+}
+
+vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<PreparedQuery>& queries) {
+	return JoinQueryResults(search_server, queries);
+}
@@ -10,3 +10,7 @@
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<PreparedQuery>& queries);
+
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<PreparedQuery>& queries);
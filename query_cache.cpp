@@ -0,0 +1,59 @@
+#include "query_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+QueryCache::QueryCache(size_t capacity)
+	: shard_capacity_(max<size_t>(1, (capacity + SHARD_COUNT - 1) / SHARD_COUNT))
+	, shards_(SHARD_COUNT) {}
+
+optional<vector<Document>> QueryCache::Find(const string& key, uint64_t epoch) {
+	Shard& shard = GetShard(key);
+	lock_guard guard(shard.mutex);
+	const auto it = shard.index.find(key);
+	if (it == shard.index.end()) {
+		miss_count_.fetch_add(1, memory_order_relaxed);
+		return nullopt;
+	}
+	if (it->second->epoch != epoch) {
+		shard.entries.erase(it->second);
+		shard.index.erase(it);
+		miss_count_.fetch_add(1, memory_order_relaxed);
+		return nullopt;
+	}
+	shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+	hit_count_.fetch_add(1, memory_order_relaxed);
+	return it->second->documents;
+}
+
+void QueryCache::Insert(const string& key, uint64_t epoch, const vector<Document>& documents) {
+	Shard& shard = GetShard(key);
+	lock_guard guard(shard.mutex);
+	const auto it = shard.index.find(key);
+	if (it != shard.index.end()) {
+		it->second->epoch = epoch;
+		it->second->documents = documents;
+		shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+		return;
+	}
+	shard.entries.push_front({ key, epoch, documents });
+	shard.index.emplace(key, shard.entries.begin());
+	if (shard.entries.size() > shard_capacity_) {
+		shard.index.erase(shard.entries.back().key);
+		shard.entries.pop_back();
+	}
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+	return { hit_count_.load(memory_order_relaxed), miss_count_.load(memory_order_relaxed) };
+}
+
+QueryCache::Shard& QueryCache::GetShard(const string& key) {
+	return shards_[hash<string>()(key) % shards_.size()];
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "document.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStats {
+	uint64_t hit_count = 0;
+	uint64_t miss_count = 0;
+};
+
+// Bounded LRU cache of search results split into independently locked shards.
+// Every entry remembers the index epoch it was computed at; entries of older epochs
+// are dropped when they are looked up.
+class QueryCache {
+public:
+	static constexpr size_t SHARD_COUNT = 16;
+
+	explicit QueryCache(size_t capacity);
+
+	std::optional<std::vector<Document>> Find(const std::string& key, uint64_t epoch);
+	void Insert(const std::string& key, uint64_t epoch, const std::vector<Document>& documents);
+
+	QueryCacheStats GetStats() const;
+
+private:
+	struct Entry {
+		std::string key;
+		uint64_t epoch;
+		std::vector<Document> documents;
+	};
+
+	struct alignas(64) Shard {
+		std::mutex mutex;
+		// Most recently used first
+		std::list<Entry> entries;
+		std::unordered_map<std::string, std::list<Entry>::iterator> index;
+	};
+
+	size_t shard_capacity_;
+	std::vector<Shard> shards_;
+	std::atomic<uint64_t> hit_count_{ 0 };
+	std::atomic<uint64_t> miss_count_{ 0 };
+
+	Shard& GetShard(const std::string& key);
+};
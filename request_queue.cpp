@@ -2,15 +2,20 @@
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
 
 #include "search_server.h"
 #include "document.h"
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
-	: server_(search_server) {}
+RequestQueue::RequestQueue(const SearchServer& search_server, size_t window_size)
+	: server_(search_server)
+	, records_(make_unique<Record[]>(max<size_t>(window_size, 1)))
+	, window_size_(max<size_t>(window_size, 1)) {
+}
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
 	return  RequestQueue::AddFindRequest(raw_query,
@@ -24,10 +29,59 @@ vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
 }
 
 int RequestQueue::GetNoResultRequests() const {
-	return count_if(requests_.begin(), requests_.end(), [](const QueryResult& item) {
-		return item.docs.size() == 0;
-		});
+	// Concurrent callers may briefly subtract an evicted outcome before adding theirs
+	return static_cast<int>(max<int64_t>(totals_.no_result_count.load(memory_order_relaxed), 0));
+}
+
+RequestStats RequestQueue::GetStats() const {
+	RequestStats stats;
+	const uint64_t request_count = request_count_.load(memory_order_relaxed);
+	stats.request_count = static_cast<size_t>(min<uint64_t>(request_count, window_size_));
+	stats.no_result_count = static_cast<size_t>(max<int64_t>(totals_.no_result_count.load(memory_order_relaxed), 0));
+	if (stats.request_count > 0) {
+		stats.average_latency_ns = static_cast<uint64_t>(max<int64_t>(totals_.latency_sum_ns.load(memory_order_relaxed), 0)) / stats.request_count;
+	}
+	if (request_count > 0) {
+		// The oldest record is the one the next request overwrites
+		const Record& oldest = records_[request_count > window_size_ ? request_count % window_size_ : 0];
+		uint64_t sequence;
+		do {
+			sequence = oldest.sequence.load(memory_order_acquire);
+			// Acquire keeps the second sequence load after this one
+			stats.first_request_ns = oldest.timestamp_ns.load(memory_order_acquire);
+		} while (sequence % 2 != 0 || oldest.sequence.load(memory_order_relaxed) != sequence);
+	}
+	stats.last_request_ns = last_request_ns_.load(memory_order_relaxed);
+	return stats;
 }
 
-RequestQueue::QueryResult::QueryResult(const std::vector<Document>& d)
-	: docs(d) {}
+void RequestQueue::AddOutcome(size_t result_count, chrono::steady_clock::time_point start) {
+	const auto now = chrono::steady_clock::now();
+	const uint64_t latency_ns = min<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(now - start).count(), MAX_LATENCY_NS);
+	const Outcome outcome = VALID_BIT | (min<uint64_t>(result_count, MAX_RESULT_COUNT) << LATENCY_BITS) | latency_ns;
+	const int64_t timestamp_ns = chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+
+	Record& record = records_[request_count_.fetch_add(1, memory_order_relaxed) % window_size_];
+	uint64_t sequence = record.sequence.load(memory_order_relaxed);
+	while (sequence % 2 != 0 || !record.sequence.compare_exchange_weak(sequence, sequence + 1, memory_order_acquire, memory_order_relaxed)) {
+		sequence = record.sequence.load(memory_order_relaxed);
+	}
+	// Release stores: a reader that sees a new field also sees the odd sequence
+	const Outcome evicted = record.outcome.load(memory_order_relaxed);
+	record.outcome.store(outcome, memory_order_release);
+	record.timestamp_ns.store(timestamp_ns, memory_order_release);
+	record.sequence.store(sequence + 2, memory_order_release);
+
+	// Every outcome is counted once when swapped in and once when swapped out
+	int64_t no_result_delta = result_count == 0 ? 1 : 0;
+	int64_t latency_delta = static_cast<int64_t>(latency_ns);
+	if (evicted & VALID_BIT) {
+		no_result_delta -= ((evicted >> LATENCY_BITS) & MAX_RESULT_COUNT) == 0 ? 1 : 0;
+		latency_delta -= static_cast<int64_t>(evicted & MAX_LATENCY_NS);
+	}
+	if (no_result_delta != 0) {
+		totals_.no_result_count.fetch_add(no_result_delta, memory_order_relaxed);
+	}
+	totals_.latency_sum_ns.fetch_add(latency_delta, memory_order_relaxed);
+	last_request_ns_.store(timestamp_ns, memory_order_relaxed);
+}
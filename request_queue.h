@@ -1,14 +1,33 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
-#include <deque>
 
 #include "search_server.h"
 #include "document.h"
 
+struct RequestStats {
+	size_t request_count = 0;
+	size_t no_result_count = 0;
+	uint64_t average_latency_ns = 0;
+	// steady_clock times of the oldest request in the window and of the newest one
+	int64_t first_request_ns = 0;
+	int64_t last_request_ns = 0;
+};
+
+// Statistics over the last requests in a fixed ring of outcome records. Callers claim
+// slots with an atomic counter and replace the record under the slot's sequence number,
+// so the running totals stay exact without a shared lock and AddFindRequest can be
+// called from many threads. Two writers meet on one slot only when the ring wraps.
 class RequestQueue {
 public:
-	explicit RequestQueue(const SearchServer& search_server);
+	static constexpr size_t DEFAULT_WINDOW_SIZE = 1440;
+
+	explicit RequestQueue(const SearchServer& search_server, size_t window_size = DEFAULT_WINDOW_SIZE);
 
 	template <typename DocumentPredicate>
 	std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
@@ -19,26 +38,46 @@ public:
 
 	int GetNoResultRequests() const;
 
+	RequestStats GetStats() const;
+
 private:
-	struct QueryResult {
-		explicit QueryResult(const std::vector<Document>& d);
+	// valid:1 | result count:15 | latency in ns:48, saturated
+	using Outcome = uint64_t;
 
-		const std::vector<Document> docs;
+	// A seqlock: the sequence is odd while a writer replaces the record, and readers
+	// retry until they see the same even sequence before and after reading the fields
+	struct Record {
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<Outcome> outcome{ 0 };
+		// steady_clock time of the request's end
+		std::atomic<int64_t> timestamp_ns{ 0 };
+	};
+
+	static constexpr int LATENCY_BITS = 48;
+	static constexpr uint64_t MAX_LATENCY_NS = (uint64_t{ 1 } << LATENCY_BITS) - 1;
+	static constexpr uint64_t MAX_RESULT_COUNT = (uint64_t{ 1 } << 15) - 1;
+	static constexpr Outcome VALID_BIT = uint64_t{ 1 } << 63;
+
+	struct alignas(64) Totals {
+		std::atomic<int64_t> no_result_count{ 0 };
+		std::atomic<int64_t> latency_sum_ns{ 0 };
 	};
 
-	std::deque<QueryResult> requests_;
-	const static int sec_in_day_ = 1440;
 	const SearchServer& server_;
+	std::unique_ptr<Record[]> records_;
+	size_t window_size_;
+	std::atomic<uint64_t> request_count_{ 0 };
+	std::atomic<int64_t> last_request_ns_{ 0 };
+	Totals totals_;
+
+	void AddOutcome(size_t result_count, std::chrono::steady_clock::time_point start);
 };
 
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-	const auto result = server_.FindTopDocuments(raw_query, document_predicate);
-	while(requests_.size() > sec_in_day_) {
-		requests_.pop_front();
-	}
-	requests_.push_back(QueryResult(result));
-	if (requests_.size() > sec_in_day_) requests_.pop_front();
+	const auto start = std::chrono::steady_clock::now();
+	auto result = server_.FindTopDocuments(raw_query, document_predicate);
+	AddOutcome(result.size(), start);
 	return result;
 }
@@ -0,0 +1,90 @@
+#include "score_accumulator.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	vector<unique_ptr<ScoreAccumulator>>& GetThreadPool() {
+		static thread_local vector<unique_ptr<ScoreAccumulator>> pool;
+		return pool;
+	}
+}
+
+ScoreAccumulator::Lease::Lease(unique_ptr<ScoreAccumulator> accumulator)
+	: accumulator_(move(accumulator)) {}
+
+ScoreAccumulator::Lease::~Lease() {
+	if (accumulator_) {
+		accumulator_->Clear();
+		GetThreadPool().push_back(move(accumulator_));
+	}
+}
+
+ScoreAccumulator* ScoreAccumulator::Lease::operator->() const {
+	return accumulator_.get();
+}
+
+ScoreAccumulator& ScoreAccumulator::Lease::operator*() const {
+	return *accumulator_;
+}
+
+ScoreAccumulator::Lease ScoreAccumulator::Acquire(int first_ordinal, int last_ordinal) {
+	auto& pool = GetThreadPool();
+	unique_ptr<ScoreAccumulator> accumulator;
+	if (pool.empty()) {
+		accumulator = make_unique<ScoreAccumulator>();
+	}
+	else {
+		accumulator = move(pool.back());
+		pool.pop_back();
+	}
+	accumulator->Reset(first_ordinal, last_ordinal);
+	return Lease(move(accumulator));
+}
+
+void ScoreAccumulator::Add(int ordinal, double score) {
+	const int slot = ordinal - first_ordinal_;
+	switch (states_[slot]) {
+	case State::UNTOUCHED:
+		states_[slot] = State::SCORED;
+		touched_.push_back(slot);
+		scores_[slot] = score;
+		break;
+	case State::SCORED:
+		scores_[slot] += score;
+		break;
+	case State::EXCLUDED:
+		break;
+	}
+}
+
+void ScoreAccumulator::Exclude(int ordinal) {
+	const int slot = ordinal - first_ordinal_;
+	if (states_[slot] == State::UNTOUCHED) {
+		touched_.push_back(slot);
+	}
+	states_[slot] = State::EXCLUDED;
+}
+
+bool ScoreAccumulator::IsExcluded(int ordinal) const {
+	return states_[ordinal - first_ordinal_] == State::EXCLUDED;
+}
+
+void ScoreAccumulator::Reset(int first_ordinal, int last_ordinal) {
+	first_ordinal_ = first_ordinal;
+	const size_t size = static_cast<size_t>(last_ordinal - first_ordinal);
+	if (states_.size() < size) {
+		scores_.resize(size);
+		states_.resize(size, State::UNTOUCHED);
+	}
+}
+
+void ScoreAccumulator::Clear() {
+	for (const int slot : touched_) {
+		states_[slot] = State::UNTOUCHED;
+	}
+	touched_.clear();
+}
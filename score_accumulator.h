@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Dense relevance accumulator over a range of document ordinals.
+// Instances are pooled per thread and reset sparsely through the list of touched slots.
+class ScoreAccumulator {
+public:
+	class Lease {
+	public:
+		explicit Lease(std::unique_ptr<ScoreAccumulator> accumulator);
+		Lease(Lease&& other) noexcept = default;
+		Lease& operator=(Lease&& other) noexcept = default;
+		~Lease();
+
+		ScoreAccumulator* operator->() const;
+		ScoreAccumulator& operator*() const;
+
+	private:
+		std::unique_ptr<ScoreAccumulator> accumulator_;
+	};
+
+	static Lease Acquire(int first_ordinal, int last_ordinal);
+
+	void Add(int ordinal, double score);
+	void Exclude(int ordinal);
+	bool IsExcluded(int ordinal) const;
+
+	template <typename Function>
+	void ForEachDocument(Function function) const;
+
+private:
+	enum class State : uint8_t {
+		UNTOUCHED,
+		SCORED,
+		EXCLUDED
+	};
+
+	int first_ordinal_ = 0;
+	std::vector<double> scores_;
+	std::vector<State> states_;
+	std::vector<int> touched_;
+
+	void Reset(int first_ordinal, int last_ordinal);
+	void Clear();
+};
+
+template <typename Function>
+void ScoreAccumulator::ForEachDocument(Function function) const {
+	for (const int slot : touched_) {
+		if (states_[slot] == State::SCORED) {
+			function(first_ordinal_ + slot, scores_[slot]);
+		}
+	}
+}
@@ -2,13 +2,26 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <set>
 #include <algorithm>
+#include <atomic>
 #include <exception>
 #include <execution>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "document.h"
+#include "index_file.h"
+#include "latency_histogram.h"
+#include "mapped_file.h"
 #include "read_input_functions.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
 
 using namespace std;
 
@@ -27,10 +40,14 @@ set<int>::iterator SearchServer::end() {
 	return document_ids_.end();
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-	static const map<string_view, double> empty_map = {};
-	if (document_to_words_.count(document_id) == 0) return empty_map;
-	return document_to_words_.at(document_id);
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+	map<string_view, double> word_freqs;
+	const auto it = document_to_ordinal_.find(document_id);
+	if (it == document_to_ordinal_.end()) return word_freqs;
+	for (const auto [term_id, term_freq] : documents_[it->second].words) {
+		word_freqs.emplace(terms_[term_id], term_freq);
+	}
+	return word_freqs;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -38,46 +55,337 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(const execution::sequenced_policy&, int document_id) {
-	if (document_to_words_.count(document_id) == 0) {
-		return;
+	const ScopedLatency latency(LatencyStage::REMOVE_DOCUMENT);
+	TombstoneDocument(document_id);
+}
+
+void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
+	// Removal only leaves a tombstone, which is O(words) and not worth splitting
+	RemoveDocument(execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+	for (const int document_id : document_ids) {
+		TombstoneDocument(document_id);
 	}
+}
 
-	for (auto& [word, freq] : document_to_words_.at(document_id)) {
-		word_to_document_freqs_.at(word).erase(document_id);
+bool SearchServer::TombstoneDocument(int document_id) {
+	const auto it = document_to_ordinal_.find(document_id);
+	if (it == document_to_ordinal_.end()) {
+		return false;
+	}
+	const int ordinal = it->second;
+	auto& words = documents_[ordinal].words;
+
+	// Postings keep the document until compaction; queries skip it by the tombstone
+	removed_ordinals_[ordinal] = true;
+	for (const auto [term_id, _] : words) {
+		auto& term = term_data_[term_id];
+		// A term left without documents is dead: queries skip it until Compact drops it
+		--term.document_freq;
+		term.log_document_freq = term.document_freq > 0 ? log(term.document_freq) : 0.0;
 	}
 
 	document_ids_.erase(document_id);
-	documents_.erase(document_id);
+	document_to_ordinal_.erase(it);
+	UpdateDocumentCount();
+	ReleaseTerms(words);
+	vector<TermFreq>().swap(words);
+	++pending_removed_count_;
+	return true;
+}
 
-	document_to_words_.erase(document_id);
+bool SearchServer::IsCompactionDue() const {
+	return pending_removed_count_ >= max<size_t>(MIN_COMPACTION_BATCH, document_to_ordinal_.size() / 4)
+		|| (dead_term_bytes_ > 0 && dead_term_bytes_ * 2 >= term_arena_.GetSize());
 }
 
-void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
-	if (document_to_words_.count(document_id) == 0) {
+vector<int> SearchServer::FindDuplicateDocuments() const {
+	vector<int> ordinals;
+	ordinals.reserve(document_to_ordinal_.size());
+	for (const auto [document_id, ordinal] : document_to_ordinal_) {
+		ordinals.push_back(ordinal);
+	}
+
+	// Words are sorted by term id, and equal word sets have equal term ids
+	vector<uint64_t> fingerprints(ordinals.size());
+	ThreadPool::GetDefault().ParallelFor(ordinals.size(), [this, &ordinals, &fingerprints](size_t i) {
+		uint64_t fingerprint = 0x9E3779B97F4A7C15ULL;
+		for (const auto [term_id, _] : documents_[ordinals[i]].words) {
+			fingerprint = (fingerprint ^ static_cast<uint64_t>(term_id)) * 0xff51afd7ed558ccdULL;
+			fingerprint ^= fingerprint >> 32;
+		}
+		fingerprints[i] = fingerprint;
+	});
+
+	const auto has_same_words = [this](int lhs, int rhs) {
+		const auto& lhs_words = documents_[lhs].words;
+		const auto& rhs_words = documents_[rhs].words;
+		return equal(lhs_words.begin(), lhs_words.end(), rhs_words.begin(), rhs_words.end(),
+			[](const TermFreq& lhs_word, const TermFreq& rhs_word) {
+				return lhs_word.term_id == rhs_word.term_id;
+			});
+	};
+
+	// The first document of every word set, in id order, is the original
+	unordered_map<uint64_t, vector<int>> originals;
+	originals.reserve(ordinals.size());
+	vector<int> duplicates;
+	for (size_t i = 0; i < ordinals.size(); ++i) {
+		auto& same_fingerprint = originals[fingerprints[i]];
+		const bool is_duplicate = any_of(same_fingerprint.begin(), same_fingerprint.end(), [&](int original) {
+			return has_same_words(original, ordinals[i]);
+		});
+		if (is_duplicate) {
+			duplicates.push_back(documents_[ordinals[i]].id);
+		}
+		else {
+			same_fingerprint.push_back(ordinals[i]);
+		}
+	}
+	return duplicates;
+}
+
+void SearchServer::Compact() {
+	if (pending_removed_count_ == 0 && dead_term_bytes_ == 0) {
 		return;
 	}
+	// Live documents and terms keep their order, so posting lists and document words
+	// stay sorted under the new numbers
+	vector<int> new_ordinals(documents_.size(), NO_ORDINAL);
+	int ordinal_count = 0;
+	for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+		if (!removed_ordinals_[ordinal]) {
+			new_ordinals[ordinal] = ordinal_count++;
+		}
+	}
+	vector<int> new_term_ids(terms_.size(), NO_TERM);
+	int term_count = 0;
+	for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+		if (term_data_[term_id].document_freq > 0) {
+			new_term_ids[term_id] = term_count++;
+		}
+	}
 
-	document_ids_.erase(document_id);
-	documents_.erase(document_id);
-
-	const auto& words = document_to_words_.at(document_id);
-	vector<string_view> words_for_delete(words.size());
-	transform(
-		execution::par,
-		words.begin(), words.end(),
-		words_for_delete.begin(),
-		[](const auto& item) {
-			return item.first;
-		}
-	);
-	for_each(
-		execution::par,
-		words_for_delete.begin(), words_for_delete.end(),
-		[this, document_id](string_view word) {
-			word_to_document_freqs_.at(word).erase(document_id);
+	// Every posting list is rewritten, since ordinals after a removed document shift
+	ThreadPool::GetDefault().ParallelFor(terms_.size(), [this, &new_ordinals, &new_term_ids](size_t term_id) {
+		auto& term = term_data_[term_id];
+		PostingList postings;
+		if (new_term_ids[term_id] != NO_TERM) {
+			PostingList::Cursor cursor(term.postings);
+			for (cursor.Next(); !cursor.IsEnd(); cursor.Next()) {
+				const int ordinal = cursor.GetDocumentId();
+				if (new_ordinals[ordinal] != NO_ORDINAL) {
+					postings.Add(new_ordinals[ordinal], cursor.GetTermCount(), cursor.GetTermCount() * documents_[ordinal].inv_word_count);
+				}
+			}
+		}
+		term.postings = move(postings);
+	});
+
+	// Items only move towards the front, onto slots already visited
+	for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+		if (new_ordinals[ordinal] != NO_ORDINAL && new_ordinals[ordinal] != static_cast<int>(ordinal)) {
+			documents_[new_ordinals[ordinal]] = move(documents_[ordinal]);
+		}
+	}
+	documents_.resize(ordinal_count);
+	documents_.shrink_to_fit();
+	for (auto& document : documents_) {
+		for (auto& word : document.words) {
+			word.term_id = new_term_ids[word.term_id];
+		}
+	}
+	for (auto& [document_id, ordinal] : document_to_ordinal_) {
+		ordinal = new_ordinals[ordinal];
+	}
+	removed_ordinals_.assign(ordinal_count, false);
+	removed_ordinals_.shrink_to_fit();
+
+	StringArena arena;
+	term_to_id_.clear();
+	for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+		const int new_term_id = new_term_ids[term_id];
+		if (new_term_id == NO_TERM) {
+			continue;
+		}
+		terms_[new_term_id] = arena.Add(terms_[term_id]);
+		if (new_term_id != static_cast<int>(term_id)) {
+			term_data_[new_term_id] = move(term_data_[term_id]);
+		}
+		term_to_id_.emplace(terms_[new_term_id], new_term_id);
+	}
+	terms_.resize(term_count);
+	terms_.shrink_to_fit();
+	term_data_.resize(term_count);
+	term_data_.shrink_to_fit();
+	term_arena_ = move(arena);
+	dead_term_bytes_ = 0;
+	pending_removed_count_ = 0;
+	// Prepared queries hold term ids, which have just changed
+	index_epoch_ = NextIndexEpoch();
+}
+
+size_t SearchServer::GetPendingRemovedCount() const {
+	return pending_removed_count_;
+}
+
+void SearchServer::Save(const string& path) const {
+	ofstream file(path, ios::binary);
+	if (!file) {
+		throw runtime_error("can't open file " + path);
+	}
+	Save(file);
+	if (!file.flush()) {
+		throw runtime_error("can't write file " + path);
+	}
+}
+
+void SearchServer::Save(ostream& output) const {
+	IndexWriter out(output);
+	out.Write(INDEX_FILE_MAGIC);
+	out.Write(INDEX_FILE_VERSION);
+
+	out.Write(static_cast<uint64_t>(stop_words_.size()));
+	for (const string_view word : stop_words_.GetWords()) {
+		out.WriteString(word);
+	}
+
+	out.Write(static_cast<uint64_t>(terms_.size()));
+	for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+		out.WriteString(terms_[term_id]);
+		out.Write(static_cast<int32_t>(term_data_[term_id].document_freq));
+		term_data_[term_id].postings.Save(out);
+	}
+
+	vector<DocumentRecord> records;
+	vector<int32_t> term_ids;
+	vector<double> term_freqs;
+	records.reserve(documents_.size());
+	for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+		const auto& document = documents_[ordinal];
+		const auto it = document_to_ordinal_.find(document.id);
+		records.push_back({
+			document.id,
+			document.rating,
+			static_cast<int32_t>(document.status),
+			it != document_to_ordinal_.end() && it->second == static_cast<int>(ordinal),
+			document.words.size(),
+			document.inv_word_count
 		});
+		for (const auto [term_id, term_freq] : document.words) {
+			term_ids.push_back(term_id);
+			term_freqs.push_back(term_freq);
+		}
+	}
+	out.WriteArray(records);
+	out.WriteArray(term_ids);
+	out.WriteArray(term_freqs);
+}
+
+SearchServer SearchServer::Load(const string& path) {
+	const MappedFile file(path);
+	return LoadIndex(file.GetData(), path);
+}
+
+SearchServer SearchServer::LoadFromMemory(string_view data) {
+	return LoadIndex(data, "in memory"s);
+}
+
+SearchServer SearchServer::LoadIndex(string_view data, const string& path) {
+	IndexReader in(data);
+	if (in.Read<uint32_t>() != INDEX_FILE_MAGIC) {
+		throw runtime_error("not an index file " + path);
+	}
+	if (in.Read<uint32_t>() != INDEX_FILE_VERSION) {
+		throw runtime_error("unsupported index file version " + path);
+	}
+
+	vector<string_view> stop_words(in.ReadCount(sizeof(uint32_t)));
+	for (string_view& word : stop_words) {
+		word = in.ReadString();
+	}
+	SearchServer server(stop_words);
+
+	// Terms without documents stay in the dictionary as dead terms, so that term ids and
+	// the compaction schedule come back exactly as saved. A term takes at least its string length, document frequency and posting list header
+	const size_t term_count = in.ReadCount(sizeof(uint32_t) + sizeof(int32_t) + 4 * sizeof(uint64_t) + 2 * sizeof(double) + sizeof(uint64_t));
+	server.terms_.resize(term_count);
+	server.term_data_.resize(term_count);
+	server.term_to_id_.reserve(term_count);
+	for (size_t term_id = 0; term_id < term_count; ++term_id) {
+		const string_view term = in.ReadString();
+		auto& term_data = server.term_data_[term_id];
+		term_data.document_freq = in.Read<int32_t>();
+		term_data.log_document_freq = term_data.document_freq > 0 ? log(term_data.document_freq) : 0.0;
+		term_data.postings.Load(in);
+		server.terms_[term_id] = server.term_arena_.Add(term);
+		if (!server.term_to_id_.emplace(server.terms_[term_id], static_cast<int>(term_id)).second) {
+			throw runtime_error("index file is corrupted " + path);
+		}
+		if (term_data.document_freq == 0) {
+			server.dead_term_bytes_ += term.size();
+		}
+	}
+
+	vector<DocumentRecord> records;
+	vector<int32_t> term_ids;
+	vector<double> term_freqs;
+	in.ReadArray(records);
+	in.ReadArray(term_ids);
+	in.ReadArray(term_freqs);
+	if (term_ids.size() != term_freqs.size() || !in.IsEnd() || records.size() > static_cast<size_t>(numeric_limits<int>::max())) {
+		throw runtime_error("index file is corrupted " + path);
+	}
+	// Ids and offsets index arrays directly, so they are checked before anything uses them
+	const auto is_valid_term_id = [term_count](int32_t term_id) {
+		return term_id >= 0 && static_cast<size_t>(term_id) < term_count;
+	};
+	if (!all_of(term_ids.begin(), term_ids.end(), is_valid_term_id)) {
+		throw runtime_error("index file is corrupted " + path);
+	}
+	for (const auto& term_data : server.term_data_) {
+		if (term_data.document_freq < 0 || static_cast<size_t>(term_data.document_freq) > term_data.postings.size()) {
+			throw runtime_error("index file is corrupted " + path);
+		}
+		try {
+			term_data.postings.Validate(static_cast<int>(records.size()));
+		}
+		catch (const runtime_error&) {
+			throw runtime_error("index file is corrupted " + path);
+		}
+	}
 
-	document_to_words_.erase(document_id);
+	server.documents_.reserve(records.size());
+	size_t word_pos = 0;
+	for (const DocumentRecord& record : records) {
+		if (record.status < static_cast<int32_t>(DocumentStatus::ACTUAL) || record.status > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+			throw runtime_error("index file is corrupted " + path);
+		}
+		const int ordinal = static_cast<int>(server.documents_.size());
+		auto& document = server.documents_.emplace_back(DocumentData{
+			record.id, record.rating, static_cast<DocumentStatus>(record.status), record.inv_word_count, {} });
+		if (record.word_count > term_ids.size() - word_pos) {
+			throw runtime_error("index file is corrupted " + path);
+		}
+		document.words.reserve(record.word_count);
+		for (size_t i = 0; i < record.word_count; ++i, ++word_pos) {
+			document.words.push_back({ term_ids[word_pos], term_freqs[word_pos] });
+		}
+		server.removed_ordinals_.push_back(!record.is_live);
+		if (record.is_live) {
+			if (!server.document_to_ordinal_.emplace(record.id, ordinal).second) {
+				throw runtime_error("index file is corrupted " + path);
+			}
+			server.document_ids_.insert(server.document_ids_.end(), record.id);
+		}
+		else {
+			++server.pending_removed_count_;
+		}
+	}
+	server.UpdateDocumentCount();
+	return server;
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -91,30 +399,170 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
 
 
 bool SearchServer::IsValidWord(string_view word) {
-	return none_of(word.begin(), word.end(), [](char c) {
-		return c >= '\0' && c < ' ';
-		});
+	return !HasControlChars(word);
 }
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-	if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+	const ScopedLatency latency(LatencyStage::ADD_DOCUMENT);
+	if ((document_id < 0) || (document_to_ordinal_.count(document_id) > 0)) {
 		throw invalid_argument("invalid document id");
 	}
 
-	const auto [it, inserted] = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, string(document) });
-	const vector<string_view> words = SplitIntoWordsNoStop(it->second.text);
+	const int ordinal = static_cast<int>(documents_.size());
+	documents_.push_back({ document_id, ComputeAverageRating(ratings), status, 0.0, {} });
+	removed_ordinals_.push_back(false);
+	document_to_ordinal_.emplace(document_id, ordinal);
+	UpdateDocumentCount();
+	static thread_local vector<string_view> words;
+	SplitIntoWordsNoStop(document, words);
 	const double inv_word_count = 1.0 / words.size();
 
+	map<int, uint32_t> term_counts;
 	for (const string_view word : words) {
-		word_to_document_freqs_[word][document_id] += inv_word_count;
-		document_to_words_[document_id][word] += inv_word_count;
+		++term_counts[AddTerm(word)];
+	}
+
+	auto& document_data = documents_[ordinal];
+	document_data.inv_word_count = inv_word_count;
+	document_data.words.reserve(term_counts.size());
+	for (const auto [term_id, term_count] : term_counts) {
+		const double term_freq = term_count * inv_word_count;
+		document_data.words.push_back({ term_id, term_freq });
+		AddPosting(term_id, ordinal, term_count, term_freq);
 	}
 
 	document_ids_.insert(document_id);
 }
 
+void SearchServer::AddDocuments(const vector<RawDocument>& documents) {
+	AddDocuments(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::sequenced_policy&, const vector<RawDocument>& documents) {
+	AddDocumentBatch(documents, 1);
+}
+
+void SearchServer::AddDocuments(const execution::parallel_policy&, const vector<RawDocument>& documents) {
+	AddDocumentBatch(documents, min(documents.size(), ThreadPool::GetDefault().GetThreadCount() + 1));
+}
+
+void SearchServer::AddDocumentBatch(const vector<RawDocument>& documents, size_t chunk_count) {
+	unordered_set<int> batch_ids;
+	for (const RawDocument& document : documents) {
+		if (document.id < 0 || document_to_ordinal_.count(document.id) > 0 || !batch_ids.insert(document.id).second) {
+			throw invalid_argument("invalid document id");
+		}
+	}
+	if (documents.empty()) {
+		return;
+	}
+
+	struct WordCount {
+		string_view word;
+		uint32_t count;
+		int term_id;
+	};
+
+	struct TokenizedDocument {
+		vector<WordCount> words;
+		double inv_word_count;
+	};
+
+	// Each chunk tokenizes its documents and inverts them into a partial index
+	struct Chunk {
+		size_t first_document;
+		size_t last_document;
+		vector<TokenizedDocument> documents;
+		unordered_map<string_view, vector<pair<size_t, WordCount*>>> word_postings;
+		exception_ptr error;
+	};
+
+	vector<Chunk> chunks(chunk_count);
+	for (size_t i = 0; i < chunk_count; ++i) {
+		chunks[i].first_document = documents.size() * i / chunk_count;
+		chunks[i].last_document = documents.size() * (i + 1) / chunk_count;
+	}
+
+	ThreadPool& thread_pool = ThreadPool::GetDefault();
+	thread_pool.ParallelFor(chunk_count, [this, &documents, &chunks](size_t chunk_index) {
+		Chunk& chunk = chunks[chunk_index];
+		try {
+			chunk.documents.resize(chunk.last_document - chunk.first_document);
+			vector<string_view> words;
+			for (size_t i = chunk.first_document; i < chunk.last_document; ++i) {
+				SplitIntoWordsNoStop(documents[i].text, words);
+				auto& tokenized = chunk.documents[i - chunk.first_document];
+				tokenized.inv_word_count = 1.0 / words.size();
+				sort(words.begin(), words.end());
+				for (const string_view word : words) {
+					if (tokenized.words.empty() || tokenized.words.back().word != word) {
+						tokenized.words.push_back({ word, 0, NO_TERM });
+					}
+					++tokenized.words.back().count;
+				}
+			}
+			for (size_t i = 0; i < chunk.documents.size(); ++i) {
+				for (WordCount& word : chunk.documents[i].words) {
+					chunk.word_postings[word.word].push_back({ chunk.first_document + i, &word });
+				}
+			}
+		}
+		catch (...) {
+			chunk.error = current_exception();
+		}
+	});
+	for (const Chunk& chunk : chunks) {
+		if (chunk.error) {
+			rethrow_exception(chunk.error);
+		}
+	}
+
+	// Chunks hold consecutive documents, so merging them in order keeps postings sorted
+	const int first_ordinal = static_cast<int>(documents_.size());
+	for (Chunk& chunk : chunks) {
+		for (auto& [word, postings] : chunk.word_postings) {
+			const int term_id = AddTerm(word);
+			auto& term = term_data_[term_id];
+			if (term.document_freq == 0) {
+				dead_term_bytes_ -= terms_[term_id].size();
+			}
+			for (const auto& [document_index, word_count] : postings) {
+				const double inv_word_count = chunk.documents[document_index - chunk.first_document].inv_word_count;
+				word_count->term_id = term_id;
+				term.postings.Add(first_ordinal + static_cast<int>(document_index), word_count->count, word_count->count * inv_word_count);
+			}
+			term.document_freq += static_cast<int>(postings.size());
+			term.log_document_freq = log(term.document_freq);
+		}
+	}
+
+	documents_.resize(documents_.size() + documents.size());
+	removed_ordinals_.resize(documents_.size(), false);
+	thread_pool.ParallelFor(chunk_count, [this, &documents, &chunks, first_ordinal](size_t chunk_index) {
+		Chunk& chunk = chunks[chunk_index];
+		for (size_t i = chunk.first_document; i < chunk.last_document; ++i) {
+			auto& tokenized = chunk.documents[i - chunk.first_document];
+			sort(tokenized.words.begin(), tokenized.words.end(), [](const WordCount& lhs, const WordCount& rhs) {
+				return lhs.term_id < rhs.term_id;
+			});
+			auto& document_data = documents_[first_ordinal + i];
+			document_data = { documents[i].id, ComputeAverageRating(documents[i].ratings), documents[i].status, tokenized.inv_word_count, {} };
+			document_data.words.reserve(tokenized.words.size());
+			for (const WordCount& word : tokenized.words) {
+				document_data.words.push_back({ word.term_id, word.count * tokenized.inv_word_count });
+			}
+		}
+	});
+
+	for (size_t i = 0; i < documents.size(); ++i) {
+		document_to_ordinal_.emplace(documents[i].id, first_ordinal + static_cast<int>(i));
+		document_ids_.insert(documents[i].id);
+	}
+	UpdateDocumentCount();
+}
+
 int SearchServer::GetDocumentCount() const {
-	return documents_.size();
+	return document_to_ordinal_.size();
 }
 
 
@@ -122,99 +570,269 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_vi
 	return MatchDocument(execution::seq, raw_query, document_id);
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, string_view raw_query, int document_id) const {
-	const auto query = ParseQuery(raw_query);
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy& policy, string_view raw_query, int document_id) const {
+	const ScopedLatency latency(LatencyStage::MATCH_DOCUMENT);
+	return MatchQuery(policy, ParseQuery(raw_query), document_id);
+}
 
-	for (const string_view word : query.minus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
-		}
-		if (word_to_document_freqs_.at(word).count(document_id)) {
-			return { {},  documents_.at(document_id).status };
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, string_view raw_query, int document_id) const {
+	const ScopedLatency latency(LatencyStage::MATCH_DOCUMENT);
+	return MatchQuery(policy, ParseQuery(raw_query), document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& query, int document_id) const {
+	return MatchDocument(execution::seq, query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy& policy, const PreparedQuery& query, int document_id) const {
+	const ScopedLatency latency(LatencyStage::MATCH_DOCUMENT);
+	Query scratch;
+	return MatchQuery(policy, ResolvePreparedQuery(query, scratch), document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, const PreparedQuery& query, int document_id) const {
+	const ScopedLatency latency(LatencyStage::MATCH_DOCUMENT);
+	Query scratch;
+	return MatchQuery(policy, ResolvePreparedQuery(query, scratch), document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchQuery(const execution::sequenced_policy&, const Query& query, int document_id) const {
+	const int ordinal = document_to_ordinal_.at(document_id);
+	const DocumentStatus status = documents_[ordinal].status;
+
+	for (const int term_id : query.minus_terms) {
+		if (HasPosting(term_id, ordinal)) {
+			return { vector<string_view>{},  status };
 		}
 	}
 
 	vector<string_view> result_words;
-	for (const string_view word : query.plus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
+	for (const int term_id : query.plus_terms) {
+		if (HasPosting(term_id, ordinal)) {
+			result_words.push_back(terms_[term_id]);
 		}
-		if (word_to_document_freqs_.at(word).count(document_id)) {
-			result_words.push_back(word);
+	}
+	return { result_words,  status };
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchQuery(const execution::parallel_policy&, const Query& query, int document_id) const {
+	const int ordinal = document_to_ordinal_.at(document_id);
+	const DocumentStatus status = documents_[ordinal].status;
+
+	ThreadPool& thread_pool = ThreadPool::GetDefault();
+	atomic<bool> has_minus_word = false;
+	thread_pool.ParallelFor(query.minus_terms.size(), [&](size_t i) {
+		if (!has_minus_word.load(memory_order_relaxed) && HasPosting(query.minus_terms[i], ordinal)) {
+			has_minus_word.store(true, memory_order_relaxed);
 		}
+	});
+	if (has_minus_word) {
+		return { vector<string_view>{}, status };
 	}
-	return { result_words,  documents_.at(document_id).status };
 
+	vector<char> is_matched(query.plus_terms.size());
+	thread_pool.ParallelFor(query.plus_terms.size(), [&](size_t i) {
+		is_matched[i] = HasPosting(query.plus_terms[i], ordinal);
+	});
 
+	// Plus terms are unique and ordered by word, so the matches need no sorting
+	vector<string_view> result_words;
+	for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+		if (is_matched[i]) {
+			result_words.push_back(terms_[query.plus_terms[i]]);
+		}
+	}
+	return { result_words, status };
+}
 
+vector<MatchedDocument> SearchServer::MatchDocuments(string_view raw_query) const {
+	return MatchDocuments(execution::seq, raw_query);
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&, string_view raw_query, int document_id) const {
-	const auto query = ParseQuery(raw_query, true);
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::sequenced_policy&, string_view raw_query) const {
+	return MatchDocumentBatch(ParseQuery(raw_query), nullptr, 1);
+}
 
-	const auto word_checker =
-		[this, document_id](string_view word) {
-		const auto it = word_to_document_freqs_.find(word);
-		return it != word_to_document_freqs_.end() && it->second.count(document_id);
-	};
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::parallel_policy&, string_view raw_query) const {
+	return MatchDocumentBatch(ParseQuery(raw_query), nullptr, min(document_to_ordinal_.size(), ThreadPool::GetDefault().GetThreadCount() + 1));
+}
 
-	if (any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), word_checker)) {
-		return { {}, documents_.at(document_id).status };
-	}
+vector<MatchedDocument> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const {
+	return MatchDocuments(execution::seq, raw_query, document_ids);
+}
 
-	vector<string_view> result_words(query.plus_words.size());
-	auto words_end = copy_if(
-		execution::par,
-		query.plus_words.begin(), query.plus_words.end(),
-		result_words.begin(),
-		word_checker
-	);
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::sequenced_policy&, string_view raw_query, const vector<int>& document_ids) const {
+	return MatchDocumentBatch(ParseQuery(raw_query), &document_ids, 1);
+}
 
-	sort(result_words.begin(), words_end);
-	words_end = unique(result_words.begin(), words_end);
-	result_words.erase(words_end, result_words.end());
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::parallel_policy&, string_view raw_query, const vector<int>& document_ids) const {
+	return MatchDocumentBatch(ParseQuery(raw_query), &document_ids, min(document_ids.size(), ThreadPool::GetDefault().GetThreadCount() + 1));
+}
 
-	return { result_words, documents_.at(document_id).status };
+vector<MatchedDocument> SearchServer::MatchDocuments(const PreparedQuery& query) const {
+	return MatchDocuments(execution::seq, query);
 }
 
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::sequenced_policy&, const PreparedQuery& query) const {
+	Query scratch;
+	return MatchDocumentBatch(ResolvePreparedQuery(query, scratch), nullptr, 1);
+}
 
-bool SearchServer::IsStopWord(string_view word) const {
-	return stop_words_.count(word) > 0;
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::parallel_policy&, const PreparedQuery& query) const {
+	Query scratch;
+	return MatchDocumentBatch(ResolvePreparedQuery(query, scratch), nullptr,
+		min(document_to_ordinal_.size(), ThreadPool::GetDefault().GetThreadCount() + 1));
 }
 
+vector<MatchedDocument> SearchServer::MatchDocuments(const PreparedQuery& query, const vector<int>& document_ids) const {
+	return MatchDocuments(execution::seq, query, document_ids);
+}
 
-vector<string_view> SearchServer::SplitIntoWords(string_view text) const {
-	vector<string_view> words;
-	if (text.empty()) return words;
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::sequenced_policy&, const PreparedQuery& query, const vector<int>& document_ids) const {
+	Query scratch;
+	return MatchDocumentBatch(ResolvePreparedQuery(query, scratch), &document_ids, 1);
+}
+
+vector<MatchedDocument> SearchServer::MatchDocuments(const execution::parallel_policy&, const PreparedQuery& query, const vector<int>& document_ids) const {
+	Query scratch;
+	return MatchDocumentBatch(ResolvePreparedQuery(query, scratch), &document_ids,
+		min(document_ids.size(), ThreadPool::GetDefault().GetThreadCount() + 1));
+}
 
-	while (true) {
-		const auto space = text.find(' ');
-		words.push_back(text.substr(0, space));
-		if (space == text.npos) {
-			break;
+vector<MatchedDocument> SearchServer::MatchDocumentBatch(const Query& query, const vector<int>* document_ids, size_t chunk_count) const {
+	vector<MatchedDocument> results;
+	// Result positions ordered by ordinal, so every posting list is walked forward once
+	vector<pair<int, size_t>> ordinal_positions;
+	if (document_ids) {
+		results.reserve(document_ids->size());
+		ordinal_positions.reserve(document_ids->size());
+		for (const int document_id : *document_ids) {
+			const int ordinal = document_to_ordinal_.at(document_id);
+			ordinal_positions.emplace_back(ordinal, results.size());
+			results.push_back({ document_id, {}, documents_[ordinal].status });
 		}
-		else {
-			text.remove_prefix(space + 1);
+	}
+	else {
+		results.reserve(document_to_ordinal_.size());
+		ordinal_positions.reserve(document_to_ordinal_.size());
+		for (const auto [document_id, ordinal] : document_to_ordinal_) {
+			ordinal_positions.emplace_back(ordinal, results.size());
+			results.push_back({ document_id, {}, documents_[ordinal].status });
 		}
 	}
-	return words;
+	sort(ordinal_positions.begin(), ordinal_positions.end());
+	chunk_count = max<size_t>(chunk_count, 1);
+
+	// Calls visit(position) for the positions in [first, last) whose documents contain the term
+	const auto intersect = [this](int term_id, const pair<int, size_t>* first, const pair<int, size_t>* last, auto visit) {
+		PostingList::Cursor cursor(term_data_[term_id].postings);
+		while (first != last) {
+			cursor.NextGeq(first->first);
+			if (cursor.IsEnd()) {
+				return;
+			}
+			const int ordinal = cursor.GetDocumentId();
+			for (; first != last && first->first < ordinal; ++first) {}
+			for (; first != last && first->first == ordinal; ++first) {
+				visit(first->second);
+			}
+		}
+	};
 
+	vector<char> is_excluded(results.size());
+	ThreadPool::GetDefault().ParallelFor(chunk_count, [&](size_t chunk) {
+		const pair<int, size_t>* first = ordinal_positions.data() + ordinal_positions.size() * chunk / chunk_count;
+		const pair<int, size_t>* last = ordinal_positions.data() + ordinal_positions.size() * (chunk + 1) / chunk_count;
+		for (const int term_id : query.minus_terms) {
+			intersect(term_id, first, last, [&is_excluded](size_t position) {
+				is_excluded[position] = true;
+			});
+		}
+		for (const int term_id : query.plus_terms) {
+			const string_view word = terms_[term_id];
+			intersect(term_id, first, last, [&results, &is_excluded, word](size_t position) {
+				if (!is_excluded[position]) {
+					results[position].words.push_back(word);
+				}
+			});
+		}
+	});
+	return results;
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
-	vector<string_view> words;
-	for (const string_view word : SplitIntoWords(text)) {
-		if (!IsValidWord(word)) {
-			throw invalid_argument("words has bad symbols");
-		}
-		if (!IsStopWord(word)) {
-			words.push_back(word);
+
+bool SearchServer::IsStopWord(string_view word) const {
+	return stop_words_.Contains(word);
+}
+
+int SearchServer::FindTermId(string_view word) const {
+	const auto it = term_to_id_.find(word);
+	return it == term_to_id_.end() || term_data_[it->second].document_freq == 0 ? NO_TERM : it->second;
+}
+
+int SearchServer::AddTerm(string_view word) {
+	const auto it = term_to_id_.find(word);
+	if (it != term_to_id_.end()) {
+		return it->second;
+	}
+	const int term_id = static_cast<int>(terms_.size());
+	const string_view term = terms_.emplace_back(term_arena_.Add(word));
+	term_to_id_.emplace(term, term_id);
+	term_data_.emplace_back();
+	// Dead until its first posting, like a term whose documents are all removed
+	dead_term_bytes_ += term.size();
+	return term_id;
+}
+
+void SearchServer::AddPosting(int term_id, int ordinal, uint32_t term_count, double term_freq) {
+	auto& term = term_data_[term_id];
+	term.postings.Add(ordinal, term_count, term_freq);
+	if (term.document_freq == 0) {
+		dead_term_bytes_ -= terms_[term_id].size();
+	}
+	term.log_document_freq = log(++term.document_freq);
+}
+
+void SearchServer::ReleaseTerms(const vector<TermFreq>& words) {
+	for (const auto [term_id, _] : words) {
+		if (term_data_[term_id].document_freq == 0) {
+			dead_term_bytes_ += terms_[term_id].size();
 		}
 	}
+}
+
+void SearchServer::UpdateDocumentCount() {
+	log_document_count_ = log(GetDocumentCount());
+	index_epoch_ = NextIndexEpoch();
+}
+
+uint64_t SearchServer::NextIndexEpoch() {
+	// Unique across servers, so that a prepared query never passes for one of another server
+	static atomic<uint64_t> next_epoch{ 1 };
+	return next_epoch.fetch_add(1, memory_order_relaxed);
+}
+
+bool SearchServer::HasPosting(int term_id, int ordinal) const {
+	return term_data_[term_id].postings.Contains(ordinal);
+}
+
+
+vector<string_view> SearchServer::SplitIntoWords(string_view text) const {
+	vector<string_view> words;
+	Tokenize(text, words);
 	return words;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+void SearchServer::SplitIntoWordsNoStop(string_view text, vector<string_view>& words) const {
+	if (!Tokenize(text, words)) {
+		throw invalid_argument("words has bad symbols");
+	}
+	words.erase(remove_if(words.begin(), words.end(), [this](string_view word) {
+		return IsStopWord(word);
+	}), words.end());
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, bool check_symbols) const {
 	if (text.empty()) throw invalid_argument("query is empty");
 	bool is_minus = false;
 
@@ -222,36 +840,99 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
 		is_minus = true;
 		text = text.substr(1);
 	}
-	if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+	if (text.empty() || text[0] == '-' || (check_symbols && !IsValidWord(text))) {
 		throw invalid_argument("query isn't correct");
 	}
 	return { text, is_minus, IsStopWord(text) };
 }
 
-SearchServer::Query SearchServer::ParseQuery(string_view text, bool skip_sort) const {
-	Query query;
-	for (const auto word : SplitIntoWords(text)) {
-		const QueryWord query_word = ParseQueryWord(word);
+SearchServer::QueryWords SearchServer::ParseQueryWords(string_view text) const {
+	static thread_local vector<string_view> raw_words;
+	// Words are checked one by one only when the text has control characters,
+	// so that errors keep their per-word order
+	const bool is_valid_text = Tokenize(text, raw_words);
+	QueryWords words;
+	for (const auto word : raw_words) {
+		const QueryWord query_word = ParseQueryWord(word, !is_valid_text);
 		if (!query_word.is_stop) {
 			if (query_word.is_minus) {
-				query.minus_words.push_back(query_word.data);
+				words.minus_words.push_back(query_word.data);
 			}
 			else {
-				query.plus_words.push_back(query_word.data);
+				words.plus_words.push_back(query_word.data);
 			}
 		}
 	}
-	if (!skip_sort) {
-		for (auto* words : { &query.plus_words, &query.minus_words }) {
-			sort(words->begin(), words->end());
-			words->erase(unique(words->begin(), words->end()), words->end());
+	for (auto* query_words : { &words.plus_words, &words.minus_words }) {
+		sort(query_words->begin(), query_words->end());
+		query_words->erase(unique(query_words->begin(), query_words->end()), query_words->end());
+	}
+	return words;
+}
+
+SearchServer::Query SearchServer::ResolveQuery(const QueryWords& words, const vector<double>* plus_word_idfs) const {
+	Query query;
+	for (size_t i = 0; i < words.plus_words.size(); ++i) {
+		const int term_id = FindTermId(words.plus_words[i]);
+		if (term_id == NO_TERM) {
+			continue;
+		}
+		query.plus_terms.push_back(term_id);
+		query.inverse_document_freqs.push_back(plus_word_idfs ? (*plus_word_idfs)[i] : ComputeWordInverseDocumentFreq(term_id));
+	}
+	for (const string_view word : words.minus_words) {
+		const int term_id = FindTermId(word);
+		if (term_id != NO_TERM) {
+			query.minus_terms.push_back(term_id);
 		}
 	}
 	return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-	return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+SearchServer::Query SearchServer::ParseQuery(string_view text) const {
+	return ResolveQuery(ParseQueryWords(text));
+}
+
+PreparedQuery SearchServer::PrepareQuery(string_view raw_query) const {
+	const QueryWords words = ParseQueryWords(raw_query);
+	PreparedQuery query;
+	query.plus_words_.assign(words.plus_words.begin(), words.plus_words.end());
+	query.minus_words_.assign(words.minus_words.begin(), words.minus_words.end());
+	query.query_ = ResolveQuery(words);
+	query.index_epoch_ = index_epoch_;
+	return query;
+}
+
+const SearchServer::Query& SearchServer::ResolvePreparedQuery(const PreparedQuery& query, Query& scratch) const {
+	if (query.index_epoch_ == index_epoch_) {
+		return query.query_;
+	}
+	scratch = ResolveQuery(query.GetWords());
+	return scratch;
+}
+
+const vector<string>& PreparedQuery::GetPlusWords() const {
+	return plus_words_;
+}
+
+const vector<string>& PreparedQuery::GetMinusWords() const {
+	return minus_words_;
+}
+
+SearchServer::QueryWords PreparedQuery::GetWords() const {
+	SearchServer::QueryWords words;
+	words.plus_words.assign(plus_words_.begin(), plus_words_.end());
+	words.minus_words.assign(minus_words_.begin(), minus_words_.end());
+	return words;
+}
+
+int SearchServer::GetDocumentFreq(string_view word) const {
+	const int term_id = FindTermId(word);
+	return term_id == NO_TERM ? 0 : term_data_[term_id].document_freq;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(int term_id) const {
+	return log_document_count_ - term_data_[term_id].log_document_freq;
 }
 
 SearchServer CreateSearchServer() {
@@ -259,10 +940,40 @@ SearchServer CreateSearchServer() {
 	return search_server;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(execution::seq, raw_query, status);
+std::vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_result_count) const {
+	return FindTopDocuments(execution::seq, raw_query, status, max_result_count);
+}
+
+void SearchServer::EnableQueryCache(size_t capacity) {
+	query_cache_ = capacity > 0 ? make_unique<QueryCache>(capacity) : nullptr;
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const {
+	return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+}
+
+string SearchServer::MakeQueryCacheKey(const QueryWords& words, DocumentStatus status, size_t max_result_count) {
+	// Words can't hold control characters, so those separate the parts
+	string key = to_string(static_cast<int>(status)) + '\x01' + to_string(max_result_count);
+	for (const string_view word : words.plus_words) {
+		key += '\x02';
+		key += word;
+	}
+	for (const string_view word : words.minus_words) {
+		key += '\x03';
+		key += word;
+	}
+	return key;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
 	return FindTopDocuments(execution::seq, raw_query);
 }
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status, size_t max_result_count) const {
+	return FindTopDocuments(execution::seq, query, status, max_result_count);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query) const {
+	return FindTopDocuments(execution::seq, query);
+}
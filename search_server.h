@@ -1,22 +1,42 @@
 #pragma once
 #include "document.h"
-#include "log_duration.h"
-#include "concurrent_map.h"
+#include "latency_histogram.h"
+#include "posting_list.h"
+#include "query_cache.h"
+#include "score_accumulator.h"
+#include "stop_word_set.h"
+#include "string_arena.h"
+#include "thread_pool.h"
+#include "top_documents.h"
 
 #include <vector>
 #include <string>
 #include <string_view>
 #include <set>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
+#include <limits>
 #include <exception>
 #include <execution>
+#include <numeric>
+#include <thread>
 #include <utility>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
 
+class PreparedQuery;
+
+namespace search_policy {
+	// Document-at-a-time evaluation with block-max MaxScore pruning
+	struct max_score_policy {};
+	inline constexpr max_score_policy max_score{};
+}
+
 class SearchServer {
 public:
 
@@ -32,61 +52,210 @@ public:
 
 	static bool IsValidWord(std::string_view word);
 	static int ComputeAverageRating(const std::vector<int>& ratings);
-	const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+	std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
 
 	void RemoveDocument(int document_id);
 	void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
 	void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
+	// Tombstones the whole batch; unknown ids are skipped
+	void RemoveDocuments(const std::vector<int>& document_ids);
+
+	// Ids of documents with the same set of words as a document with a smaller id,
+	// found by fingerprints of the term sets and checked exactly on fingerprint matches
+	std::vector<int> FindDuplicateDocuments() const;
+
+	// Removed documents stay in postings behind a tombstone, and their terms in the
+	// dictionary, until Compact renumbers the live documents and terms and rewrites every
+	// posting list. Compaction is synchronous, not a background task: removal never
+	// compacts, and the owner calls Compact, e.g. once IsCompactionDue, where a pause is
+	// acceptable. SnapshotSearchServer does it in Write, away from its readers
+	void Compact();
+	bool IsCompactionDue() const;
+	size_t GetPendingRemovedCount() const;
+
 	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+	// Adds the whole batch or nothing: ids and words are validated before the index changes
+	void AddDocuments(const std::vector<RawDocument>& documents);
+	void AddDocuments(const std::execution::sequenced_policy&, const std::vector<RawDocument>& documents);
+	void AddDocuments(const std::execution::parallel_policy&, const std::vector<RawDocument>& documents);
+
 	template <typename ExecutionPolicy, typename DocumentPredicate>
-	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	template <typename ExecutionPolicy>
-	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	template <typename ExecutionPolicy>
 	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
 
 
 	template <typename DocumentPredicate>
-	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
 	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+	// Parses and resolves the query once; every search and match overload below also takes
+	// the result, so repeated queries skip parsing and dictionary lookups
+	PreparedQuery PrepareQuery(std::string_view raw_query) const;
+
+	template <typename ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& query, DocumentPredicate document_predicate,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& query, DocumentStatus status,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& query) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus status,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(const PreparedQuery& query) const;
+
 	int GetDocumentCount() const;
 
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery& query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, const PreparedQuery& query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, const PreparedQuery& query, int document_id) const;
+
+	// Matches the query against many documents with one parse and one walk of every query
+	// posting list. Results follow document_ids, or go by id over all documents when it is
+	// omitted; an unknown id throws out_of_range. The parallel overloads split the documents
+	std::vector<MatchedDocument> MatchDocuments(std::string_view raw_query) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::sequenced_policy&, std::string_view raw_query) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::parallel_policy&, std::string_view raw_query) const;
+	std::vector<MatchedDocument> MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::sequenced_policy&, std::string_view raw_query,
+		const std::vector<int>& document_ids) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::parallel_policy&, std::string_view raw_query,
+		const std::vector<int>& document_ids) const;
+	std::vector<MatchedDocument> MatchDocuments(const PreparedQuery& query) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::sequenced_policy&, const PreparedQuery& query) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::parallel_policy&, const PreparedQuery& query) const;
+	std::vector<MatchedDocument> MatchDocuments(const PreparedQuery& query, const std::vector<int>& document_ids) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::sequenced_policy&, const PreparedQuery& query,
+		const std::vector<int>& document_ids) const;
+	std::vector<MatchedDocument> MatchDocuments(const std::execution::parallel_policy&, const PreparedQuery& query,
+		const std::vector<int>& document_ids) const;
+
+	// Caches results of status-filtered searches, keyed by the parsed query; any change
+	// of the document set invalidates them. Capacity 0 turns the cache off
+	void EnableQueryCache(size_t capacity);
+	QueryCacheStats GetQueryCacheStats() const;
+
+	// Writes the whole index to a versioned binary file. Load maps the file but does not
+	// serve from the mapping: it copies every section into a regular server, interns the
+	// terms again and decodes every posting block to validate it, so loading is O(index
+	// size). What it saves is tokenizing and re-encoding; the mapping is a read buffer
+	void Save(const std::string& path) const;
+	void Save(std::ostream& out) const;
+	static SearchServer Load(const std::string& path);
+	// Loads an index written by Save(ostream&) from memory; the data may go away afterwards
+	static SearchServer LoadFromMemory(std::string_view data);
 
 private:
+	friend class ShardedSearchServer;
+	friend class PreparedQuery;
+
+	struct TermFreq {
+		int term_id;
+		double term_freq;
+	};
 
 	struct DocumentData {
+		int id;
 		int rating;
 		DocumentStatus status;
-		std::string text;
+		// Postings keep term counts; term_freq = term_count * inv_word_count
+		double inv_word_count;
+		std::vector<TermFreq> words;
+	};
+
+	struct TermData {
+		PostingList postings;
+		int document_freq = 0;
+		// log(document_freq), so IDF is a subtraction from log_document_count_
+		double log_document_freq = 0.0;
 	};
 
-	const std::set<std::string, std::less<>> stop_words_;
-	std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-	std::map<int, std::map<std::string_view, double>> document_to_words_;
-	std::map<int, DocumentData> documents_;
+	// Fixed-size document entry of the index file
+	struct DocumentRecord {
+		int32_t id;
+		int32_t rating;
+		int32_t status;
+		int32_t is_live;
+		uint64_t word_count;
+		double inv_word_count;
+	};
+
+	static constexpr int NO_TERM = -1;
+	static constexpr int NO_ORDINAL = -1;
+	static constexpr size_t MIN_COMPACTION_BATCH = 256;
+
+	const StopWordSet stop_words_;
+	StringArena term_arena_;
+	// Views into term_arena_; terms left without documents are dropped by Compact
+	std::vector<std::string_view> terms_;
+	std::unordered_map<std::string_view, int> term_to_id_;
+	// Total size of the terms in terms_ that have no documents
+	size_t dead_term_bytes_ = 0;
+	// Postings and accumulators address documents by ordinal, the index in documents_
+	std::vector<TermData> term_data_;
+	std::vector<DocumentData> documents_;
+	std::map<int, int> document_to_ordinal_;
+	// Tombstones by ordinal
+	std::vector<bool> removed_ordinals_;
+	size_t pending_removed_count_ = 0;
 	std::set<int> document_ids_;
+	double log_document_count_ = 0.0;
+	// Renewed on every change of the document set; epochs are unique across servers
+	uint64_t index_epoch_ = NextIndexEpoch();
+	std::unique_ptr<QueryCache> query_cache_;
 
 
 
 	bool IsStopWord(std::string_view word) const;
 
+	int FindTermId(std::string_view word) const;
+	int AddTerm(std::string_view word);
+	void AddPosting(int term_id, int ordinal, uint32_t term_count, double term_freq);
+	bool TombstoneDocument(int document_id);
+	// Counts the bytes of terms left without documents
+	void ReleaseTerms(const std::vector<TermFreq>& words);
+	void UpdateDocumentCount();
+	static uint64_t NextIndexEpoch();
+	// path only names the source in error messages
+	static SearchServer LoadIndex(std::string_view data, const std::string& path);
+
+	void AddDocumentBatch(const std::vector<RawDocument>& documents, size_t chunk_count);
+
+	bool HasPosting(int term_id, int ordinal) const;
+
+
 	template <typename StringContainer>
 	std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings);
 
 	std::vector<std::string_view> SplitIntoWords(std::string_view text) const;
 
-	std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+	// Reuses the words buffer; throws on control characters
+	void SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const;
 
 
 	struct QueryWord {
@@ -95,32 +264,92 @@ private:
 		bool is_stop;
 	};
 
-	QueryWord ParseQueryWord(std::string_view text) const;
+	QueryWord ParseQueryWord(std::string_view text, bool check_symbols) const;
 
-	struct Query {
+	struct QueryWords {
 		std::vector<std::string_view> plus_words;
 		std::vector<std::string_view> minus_words;
 	};
 
-	Query ParseQuery(std::string_view text, bool skip_sort = false) const;
+	struct Query {
+		std::vector<int> plus_terms;
+		std::vector<int> minus_terms;
+		// Parallel to plus_terms
+		std::vector<double> inverse_document_freqs;
+	};
+
+	QueryWords ParseQueryWords(std::string_view text) const;
+
+	// Words absent from the dictionary are dropped. plus_word_idfs, when given, is parallel
+	// to words.plus_words and replaces the local IDF (used for collection-wide statistics)
+	Query ResolveQuery(const QueryWords& words, const std::vector<double>* plus_word_idfs = nullptr) const;
+
+	Query ParseQuery(std::string_view text) const;
+
+	// The resolved terms of the prepared query while the index is unchanged; otherwise
+	// its words resolved again into scratch
+	const Query& ResolvePreparedQuery(const PreparedQuery& query, Query& scratch) const;
+
+	// document_ids == nullptr stands for all documents
+	std::vector<MatchedDocument> MatchDocumentBatch(const Query& query, const std::vector<int>* document_ids, size_t chunk_count) const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQuery(const std::execution::sequenced_policy&, const Query& query, int document_id) const;
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQuery(const std::execution::parallel_policy&, const Query& query, int document_id) const;
+
+	static std::string MakeQueryCacheKey(const QueryWords& words, DocumentStatus status, size_t max_result_count);
 
-	double ComputeWordInverseDocumentFreq(std::string_view word) const;
+	int GetDocumentFreq(std::string_view word) const;
+
+	double ComputeWordInverseDocumentFreq(int term_id) const;
+
+	template <typename DocumentPredicate>
+	// With latencies, the stages are collected there for the caller to record
+	std::vector<Document> FindDocumentsInRange(const Query& query, DocumentPredicate document_predicate,
+		int first_ordinal, int last_ordinal, size_t max_result_count, StageLatencies* latencies = nullptr) const;
 
 	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate, size_t max_result_count) const;
 
 	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate,
+		size_t max_result_count) const;
 
 	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate,
+		size_t max_result_count) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindAllDocuments(const search_policy::max_score_policy&, const Query& query, DocumentPredicate document_predicate,
+		size_t max_result_count) const;
+
+};
 
+// A query parsed by SearchServer::PrepareQuery. It owns its words, so it outlives the raw
+// query text, and can be shared by threads. Term ids and IDFs are kept for the index epoch
+// they were resolved at: after documents change, or on another server, only the words
+// are resolved again
+class PreparedQuery {
+public:
+	const std::vector<std::string>& GetPlusWords() const;
+	const std::vector<std::string>& GetMinusWords() const;
+
+private:
+	friend class SearchServer;
+
+	// Sorted and unique, like the words of a parsed query
+	std::vector<std::string> plus_words_;
+	std::vector<std::string> minus_words_;
+	SearchServer::Query query_;
+	uint64_t index_epoch_ = 0;
+
+	SearchServer::QueryWords GetWords() const;
 };
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
 	: stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
-	if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord))
+	const std::vector<std::string_view> words = stop_words_.GetWords();
+	if (!all_of(words.begin(), words.end(), IsValidWord))
 		throw std::invalid_argument("words has bad symbols");
 }
 
@@ -137,10 +366,26 @@ std::set<std::string, std::less<>> SearchServer::MakeUniqueNonEmptyStrings(const
 
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+	size_t max_result_count) const {
+	const auto status_predicate = [status](int document_id, DocumentStatus document_status, int rating) {
 		return document_status == status;
-	});
+	};
+	if (!query_cache_) {
+		return FindTopDocuments(policy, raw_query, status_predicate, max_result_count);
+	}
+
+	LatencyTimer timer;
+	const QueryWords words = ParseQueryWords(raw_query);
+	const std::string key = MakeQueryCacheKey(words, status, max_result_count);
+	if (auto documents = query_cache_->Find(key, index_epoch_)) {
+		return std::move(*documents);
+	}
+	const auto query = ResolveQuery(words);
+	timer.Lap(LatencyStage::PARSE);
+	auto documents = FindAllDocuments(policy, query, status_predicate, max_result_count);
+	query_cache_->Insert(key, index_epoch_, documents);
+	return documents;
 }
 
 template <typename ExecutionPolicy>
@@ -149,111 +394,264 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	LatencyTimer timer;
 	const auto query = ParseQuery(raw_query);
-	std::vector<Document> matched_documents = FindAllDocuments(policy, query, document_predicate);
+	timer.Lap(LatencyStage::PARSE);
+	return FindAllDocuments(policy, query, document_predicate, max_result_count);
+}
 
-	std::sort(
-		matched_documents.begin(),
-		matched_documents.end(),
-		[](const Document& lhs, const Document& rhs) {
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
+}
 
-			if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-				return lhs.rating > rhs.rating;
-			} else {
-				return lhs.relevance > rhs.relevance;
-			}
-	});
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& query, DocumentStatus status,
+	size_t max_result_count) const {
+	const auto status_predicate = [status](int document_id, DocumentStatus document_status, int rating) {
+		return document_status == status;
+	};
+	if (!query_cache_) {
+		return FindTopDocuments(policy, query, status_predicate, max_result_count);
+	}
 
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+	const std::string key = MakeQueryCacheKey(query.GetWords(), status, max_result_count);
+	if (auto documents = query_cache_->Find(key, index_epoch_)) {
+		return std::move(*documents);
 	}
+	auto documents = FindTopDocuments(policy, query, status_predicate, max_result_count);
+	query_cache_->Insert(key, index_epoch_, documents);
+	return documents;
+}
 
-	return matched_documents;
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& query) const {
+	return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const PreparedQuery& query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	LatencyTimer timer;
+	Query scratch;
+	const Query& resolved_query = ResolvePreparedQuery(query, scratch);
+	timer.Lap(LatencyStage::PARSE);
+	return FindAllDocuments(policy, resolved_query, document_predicate, max_result_count);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-	return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	return FindTopDocuments(std::execution::seq, query, document_predicate, max_result_count);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-	std::map<int, double> document_to_relevance;
-	for (std::string_view word : query.plus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
-			continue;
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	return FindDocumentsInRange(query, document_predicate, 0, static_cast<int>(documents_.size()), max_result_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate, size_t max_result_count) const {
+	return FindAllDocuments(std::execution::seq, query, document_predicate, max_result_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	ThreadPool& thread_pool = ThreadPool::GetDefault();
+	const int ordinal_count = static_cast<int>(documents_.size());
+	const int chunk_count = std::max(1, std::min(ordinal_count, static_cast<int>(thread_pool.GetThreadCount() + 1)));
+
+	// Every stage is recorded once per query: chunks run side by side, so a stage takes
+	// as long as in the slowest chunk, and merging the chunks adds to TOP_K
+	std::vector<StageLatencies> chunk_latencies(chunk_count);
+	std::vector<std::vector<Document>> chunk_documents(chunk_count);
+	thread_pool.ParallelFor(chunk_count, [&](size_t chunk) {
+		const int first_ordinal = static_cast<int>(static_cast<int64_t>(ordinal_count) * chunk / chunk_count);
+		const int last_ordinal = static_cast<int>(static_cast<int64_t>(ordinal_count) * (chunk + 1) / chunk_count);
+		chunk_documents[chunk] = FindDocumentsInRange(query, document_predicate, first_ordinal, last_ordinal, max_result_count,
+			&chunk_latencies[chunk]);
+	});
+	StageLatencies latencies;
+	for (const StageLatencies& chunk : chunk_latencies) {
+		latencies.MergeParallel(chunk);
+	}
+
+	LatencyTimer timer(&latencies);
+	TopDocuments top_documents(max_result_count);
+	for (const auto& documents : chunk_documents) {
+		for (const Document& document : documents) {
+			top_documents.Add(document);
 		}
+	}
+	auto documents = top_documents.Extract();
+	timer.Lap(LatencyStage::TOP_K);
+	latencies.Record();
+	return documents;
+}
 
-		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-		for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-			const auto& document_data = documents_.at(document_id);
-			if (document_predicate(document_id, document_data.status, document_data.rating)) {
-				document_to_relevance[document_id] += term_freq * inverse_document_freq;
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindDocumentsInRange(const Query& query, DocumentPredicate document_predicate,
+	int first_ordinal, int last_ordinal, size_t max_result_count, StageLatencies* latencies) const {
+	LatencyTimer timer(latencies);
+	const auto accumulator = ScoreAccumulator::Acquire(first_ordinal, last_ordinal);
+
+	for (const int term_id : query.minus_terms) {
+		PostingList::Cursor cursor(term_data_[term_id].postings);
+		for (cursor.NextGeq(first_ordinal); !cursor.IsEnd() && cursor.GetDocumentId() < last_ordinal; cursor.Next()) {
+			accumulator->Exclude(cursor.GetDocumentId());
+		}
+	}
+	timer.Lap(LatencyStage::MINUS_WORDS);
+
+	for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+		const double inverse_document_freq = query.inverse_document_freqs[i];
+		PostingList::Cursor cursor(term_data_[query.plus_terms[i]].postings);
+		for (cursor.NextGeq(first_ordinal); !cursor.IsEnd() && cursor.GetDocumentId() < last_ordinal; cursor.Next()) {
+			const int ordinal = cursor.GetDocumentId();
+			if (removed_ordinals_[ordinal] || accumulator->IsExcluded(ordinal)) {
+				continue;
 			}
+			accumulator->Add(ordinal, cursor.GetTermCount() * documents_[ordinal].inv_word_count * inverse_document_freq);
 		}
 	}
+	timer.Lap(LatencyStage::POSTINGS);
+
+	// The predicate runs once per scored document rather than once per posting
+	TopDocuments top_documents(max_result_count);
+	accumulator->ForEachDocument([this, &top_documents, &document_predicate](int ordinal, double relevance) {
+		const auto& document_data = documents_[ordinal];
+		if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+			top_documents.Add({ document_data.id, relevance, document_data.rating });
+		}
+	});
+	timer.Lap(LatencyStage::FILTER);
+	auto documents = top_documents.Extract();
+	timer.Lap(LatencyStage::TOP_K);
+	return documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const search_policy::max_score_policy&, const Query& query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	// Pruning interleaves every stage, so all of it up to the final ordering counts as POSTINGS
+	LatencyTimer timer;
+	struct TermCursor {
+		PostingList::Cursor cursor;
+		double inverse_document_freq;
+		double max_score;
+	};
 
-	for (std::string_view word : query.minus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
+	std::vector<TermCursor> terms;
+	for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+		const auto& postings = term_data_[query.plus_terms[i]].postings;
+		if (postings.empty()) {
 			continue;
 		}
-		for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-			document_to_relevance.erase(document_id);
-		}
+		const double inverse_document_freq = query.inverse_document_freqs[i];
+		terms.push_back({ PostingList::Cursor(postings), inverse_document_freq, postings.GetMaxTermFreq() * inverse_document_freq });
+		terms.back().cursor.Next();
 	}
+	std::sort(terms.begin(), terms.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+		return lhs.max_score < rhs.max_score;
+	});
 
-	std::vector<Document> matched_documents;
-	for (const auto [document_id, relevance] : document_to_relevance) {
-		matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+	// max_score_prefix[i] bounds the total score of terms[0..i]
+	std::vector<double> max_score_prefix(terms.size());
+	double max_score_sum = 0.0;
+	for (size_t i = 0; i < terms.size(); ++i) {
+		max_score_sum += terms[i].max_score;
+		max_score_prefix[i] = max_score_sum;
 	}
-	return matched_documents;
-}
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-	return FindAllDocuments(std::execution::seq, query, document_predicate);
-}
+	std::vector<PostingList::Cursor> minus_cursors;
+	for (const int term_id : query.minus_terms) {
+		minus_cursors.emplace_back(term_data_[term_id].postings);
+	}
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-	ConcurrentMap<int, double> document_to_relevance(97);
-
-	std::for_each(
-		std::execution::par,
-		query.plus_words.begin(), query.plus_words.end(),
-		[this, document_predicate, &document_to_relevance](std::string_view word) {
-			if (word_to_document_freqs_.count(word) == 0) {
-				return;
+	TopDocuments top_documents(max_result_count);
+	if (max_result_count == 0) {
+		return top_documents.Extract();
+	}
+
+	// Documents scoring below the threshold can't enter the top even by rating
+	double threshold = std::numeric_limits<double>::lowest();
+	size_t first_essential = 0;
+	while (true) {
+		int ordinal = std::numeric_limits<int>::max();
+		for (size_t i = first_essential; i < terms.size(); ++i) {
+			if (!terms[i].cursor.IsEnd()) {
+				ordinal = std::min(ordinal, terms[i].cursor.GetDocumentId());
 			}
-			const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-			for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-				const auto& document_data = documents_.at(document_id);
-				if (document_predicate(document_id, document_data.status, document_data.rating)) {
-					document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-				}
+		}
+		if (ordinal == std::numeric_limits<int>::max()) {
+			break;
+		}
+
+		const auto& document_data = documents_[ordinal];
+		const bool is_removed = removed_ordinals_[ordinal];
+		double relevance = 0.0;
+		for (size_t i = first_essential; i < terms.size(); ++i) {
+			auto& cursor = terms[i].cursor;
+			if (!cursor.IsEnd() && cursor.GetDocumentId() == ordinal) {
+				relevance += cursor.GetTermCount() * document_data.inv_word_count * terms[i].inverse_document_freq;
+				cursor.Next();
 			}
 		}
-	);
-
-	std::for_each(
-		std::execution::par,
-		query.minus_words.begin(), query.minus_words.end(),
-		[this, &document_to_relevance](std::string_view word) {
-			if (word_to_document_freqs_.count(word) == 0) {
-				return;
+		if (is_removed) {
+			continue;
+		}
+
+		double block_bound = relevance;
+		for (size_t i = 0; i < first_essential; ++i) {
+			block_bound += terms[i].cursor.GetBlockMaxTermFreq(ordinal) * terms[i].inverse_document_freq;
+		}
+		if (block_bound < threshold) {
+			continue;
+		}
+
+		for (size_t i = first_essential; i-- > 0;) {
+			if (relevance + max_score_prefix[i] < threshold) {
+				break;
 			}
-			for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-				document_to_relevance.erase(document_id);
+			auto& cursor = terms[i].cursor;
+			cursor.NextGeq(ordinal);
+			if (!cursor.IsEnd() && cursor.GetDocumentId() == ordinal) {
+				relevance += cursor.GetTermCount() * document_data.inv_word_count * terms[i].inverse_document_freq;
 			}
 		}
-	);
+		if (relevance < threshold) {
+			continue;
+		}
+
+		const bool has_minus_word = std::any_of(minus_cursors.begin(), minus_cursors.end(), [ordinal](PostingList::Cursor& cursor) {
+			cursor.NextGeq(ordinal);
+			return !cursor.IsEnd() && cursor.GetDocumentId() == ordinal;
+		});
+		if (has_minus_word) {
+			continue;
+		}
 
-	std::vector<Document> matched_documents;
-	for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-		matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+		if (!document_predicate(document_data.id, document_data.status, document_data.rating)) {
+			continue;
+		}
+
+		top_documents.Add({ document_data.id, relevance, document_data.rating });
+		if (top_documents.IsFull()) {
+			threshold = top_documents.GetWorst().relevance - EPSILON;
+			while (first_essential < terms.size() && max_score_prefix[first_essential] < threshold) {
+				++first_essential;
+			}
+		}
 	}
-	return matched_documents;
+	timer.Lap(LatencyStage::POSTINGS);
+	auto documents = top_documents.Extract();
+	timer.Lap(LatencyStage::TOP_K);
+	return documents;
 }
 
 SearchServer CreateSearchServer();
@@ -0,0 +1,93 @@
+#include "sharded_search_server.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <execution>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(const string& stop_words_text, size_t shard_count)
+	: ShardedSearchServer(string_view(stop_words_text), shard_count) {}
+
+ShardedSearchServer::ShardedSearchServer(string_view stop_words_text, size_t shard_count) {
+	if (shard_count == 0) {
+		throw invalid_argument("shard count must be positive");
+	}
+	shards_.reserve(shard_count);
+	for (size_t i = 0; i < shard_count; ++i) {
+		shards_.emplace_back(stop_words_text);
+	}
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+	if (document_id < 0) {
+		throw invalid_argument("invalid document id");
+	}
+	GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+	if (document_id >= 0) {
+		GetShard(document_id).RemoveDocument(document_id);
+	}
+}
+
+void ShardedSearchServer::Compact() {
+	ThreadPool::GetDefault().ParallelFor(shards_.size(), [this](size_t i) {
+		shards_[i].Compact();
+	});
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_result_count) const {
+	return FindTopDocuments(execution::seq, raw_query, status, max_result_count);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+	return FindTopDocuments(execution::seq, raw_query);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+	if (document_id < 0) {
+		throw out_of_range("invalid document id");
+	}
+	return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+	int document_count = 0;
+	for (const SearchServer& shard : shards_) {
+		document_count += shard.GetDocumentCount();
+	}
+	return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+	return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+	return shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+	return shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
+
+vector<double> ShardedSearchServer::ComputeInverseDocumentFreqs(const SearchServer::QueryWords& words) const {
+	const double log_document_count = log(GetDocumentCount());
+	vector<double> inverse_document_freqs;
+	inverse_document_freqs.reserve(words.plus_words.size());
+	for (const string_view word : words.plus_words) {
+		int document_freq = 0;
+		for (const SearchServer& shard : shards_) {
+			document_freq += shard.GetDocumentFreq(word);
+		}
+		inverse_document_freqs.push_back(log_document_count - log(document_freq));
+	}
+	return inverse_document_freqs;
+}
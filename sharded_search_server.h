@@ -0,0 +1,117 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// Partitions documents across independent SearchServer shards by id. Queries run on all
+// shards in parallel with collection-wide IDF, so rankings match a single server.
+class ShardedSearchServer {
+public:
+	template <typename StringContainer>
+	ShardedSearchServer(const StringContainer& stop_words, size_t shard_count);
+
+	ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+	ShardedSearchServer(std::string_view stop_words_text, size_t shard_count);
+
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+	void RemoveDocument(int document_id);
+
+	// Compacts the shards in parallel, see SearchServer::Compact
+	void Compact();
+
+	template <typename ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+		size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+	int GetDocumentCount() const;
+
+	size_t GetShardCount() const;
+
+private:
+	std::vector<SearchServer> shards_;
+
+	const SearchServer& GetShard(int document_id) const;
+	SearchServer& GetShard(int document_id);
+
+	std::vector<double> ComputeInverseDocumentFreqs(const SearchServer::QueryWords& words) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer& stop_words, size_t shard_count) {
+	if (shard_count == 0) {
+		throw std::invalid_argument("shard count must be positive");
+	}
+	shards_.reserve(shard_count);
+	for (size_t i = 0; i < shard_count; ++i) {
+		shards_.emplace_back(stop_words);
+	}
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	const auto words = shards_.front().ParseQueryWords(raw_query);
+	const std::vector<double> inverse_document_freqs = ComputeInverseDocumentFreqs(words);
+
+	std::vector<std::vector<Document>> shard_documents(shards_.size());
+	ThreadPool::GetDefault().ParallelFor(shards_.size(), [&](size_t shard) {
+		const auto query = shards_[shard].ResolveQuery(words, &inverse_document_freqs);
+		shard_documents[shard] = shards_[shard].FindAllDocuments(policy, query, document_predicate, max_result_count);
+	});
+
+	TopDocuments top_documents(max_result_count);
+	for (const auto& documents : shard_documents) {
+		for (const Document& document : documents) {
+			top_documents.Add(document);
+		}
+	}
+	return top_documents.Extract();
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+	size_t max_result_count) const {
+	return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+		return document_status == status;
+	}, max_result_count);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const {
+	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+	size_t max_result_count) const {
+	return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_result_count);
+}
@@ -0,0 +1,116 @@
+#include "snapshot_search_server.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+SnapshotSearchServer::SnapshotSearchServer(const string& stop_words_text)
+	: SnapshotSearchServer(string_view(stop_words_text)) {}
+
+SnapshotSearchServer::SnapshotSearchServer(string_view stop_words_text) {
+	for (auto& replica : replicas_) {
+		replica = make_unique<SearchServer>(stop_words_text);
+	}
+}
+
+void SnapshotSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+	Write([&](SearchServer& server) {
+		server.AddDocument(document_id, document, status, ratings);
+	});
+}
+
+void SnapshotSearchServer::AddDocuments(const vector<RawDocument>& documents) {
+	Write([&documents](SearchServer& server) {
+		server.AddDocuments(documents);
+	});
+}
+
+void SnapshotSearchServer::RemoveDocument(int document_id) {
+	Write([document_id](SearchServer& server) {
+		server.RemoveDocument(document_id);
+	});
+}
+
+tuple<vector<string>, DocumentStatus> SnapshotSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+	return Read([&](const SearchServer& server) {
+		const auto [words, status] = server.MatchDocument(raw_query, document_id);
+		return tuple<vector<string>, DocumentStatus>{ vector<string>(words.begin(), words.end()), status };
+	});
+}
+
+map<string, double> SnapshotSearchServer::GetWordFrequencies(int document_id) const {
+	return Read([document_id](const SearchServer& server) {
+		map<string, double> word_freqs;
+		for (const auto& [word, freq] : server.GetWordFrequencies(document_id)) {
+			word_freqs.emplace(word, freq);
+		}
+		return word_freqs;
+	});
+}
+
+int SnapshotSearchServer::GetDocumentCount() const {
+	return Read([](const SearchServer& server) {
+		return server.GetDocumentCount();
+	});
+}
+
+SnapshotSearchServer::ReadGuard::ReadGuard(const SnapshotSearchServer& server)
+	: server_(server)
+	, stripe_(server.GetReaderStripe()) {
+	// Registering and then re-checking the published replica means a writer that switched
+	// in between either sees this reader or this reader moves on to the new replica
+	while (true) {
+		replica_ = server_.published_replica_.load();
+		stripe_.counts[replica_].fetch_add(1);
+		if (server_.published_replica_.load() == replica_) {
+			break;
+		}
+		stripe_.counts[replica_].fetch_sub(1);
+	}
+}
+
+SnapshotSearchServer::ReadGuard::~ReadGuard() {
+	stripe_.counts[replica_].fetch_sub(1);
+}
+
+const SearchServer& SnapshotSearchServer::ReadGuard::Get() const {
+	return *server_.replicas_[replica_];
+}
+
+SnapshotSearchServer::ReaderStripe& SnapshotSearchServer::GetReaderStripe() const {
+	thread_local const size_t stripe = hash<thread::id>()(this_thread::get_id()) % READER_STRIPE_COUNT;
+	return reader_stripes_[stripe];
+}
+
+void SnapshotSearchServer::WaitForReaders(int replica) const {
+	for (const ReaderStripe& stripe : reader_stripes_) {
+		while (stripe.counts[replica].load() != 0) {
+			this_thread::yield();
+		}
+	}
+}
+
+void SnapshotSearchServer::CompactIfDue(SearchServer& replica) {
+	if (replica.IsCompactionDue()) {
+		replica.Compact();
+	}
+}
+
+void SnapshotSearchServer::RebuildHiddenReplica() {
+	const int published = published_replica_.load();
+	// Readers may search the published replica meanwhile: saving only reads it
+	ostringstream index;
+	replicas_[published]->Save(index);
+	replicas_[1 - published] = make_unique<SearchServer>(SearchServer::LoadFromMemory(index.str()));
+	is_hidden_replica_stale_ = false;
+}
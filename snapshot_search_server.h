@@ -0,0 +1,153 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// SearchServer for concurrent reads during updates. It keeps two replicas (the left-right
+// flavor of RCU): readers use the published one and never wait, while the single writer
+// changes the other, publishes it, waits for readers of the old one to leave and then
+// repeats the change there. Updates cost twice the work and the index takes twice the memory.
+class SnapshotSearchServer {
+public:
+	template <typename StringContainer>
+	explicit SnapshotSearchServer(const StringContainer& stop_words);
+
+	explicit SnapshotSearchServer(const std::string& stop_words_text);
+	explicit SnapshotSearchServer(std::string_view stop_words_text);
+
+	// Applies the same update to both replicas; an exception from the first one is rethrown
+	// after the second, so the replicas stay identical
+	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+	void AddDocuments(const std::vector<RawDocument>& documents);
+	void RemoveDocument(int document_id);
+
+	// Calls function(SearchServer&) on each replica in turn, so several changes
+	// become visible to readers at once, and compacts the replica when due, so readers
+	// never wait for compaction. function must be deterministic. When it fails
+	// on one replica only, the other one is rebuilt from the published replica and the
+	// exception is rethrown. The rebuild goes through the index format, which keeps term
+	// ids, dead terms and tombstones, so both replicas compact at the same points; only
+	// the query cache is not carried over
+	template <typename Function>
+	void Write(Function function);
+
+	// Calls function(const SearchServer&) on the published replica. Views into the replica
+	// must not leave the function: the replica changes once the call returns
+	template <typename Function>
+	auto Read(Function function) const;
+
+	template <typename... Args>
+	std::vector<Document> FindTopDocuments(const Args&... args) const;
+
+	std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+	std::map<std::string, double> GetWordFrequencies(int document_id) const;
+
+	int GetDocumentCount() const;
+
+private:
+	static constexpr size_t READER_STRIPE_COUNT = 16;
+
+	// Readers of each replica, spread over cache lines to keep readers from contending
+	struct alignas(64) ReaderStripe {
+		std::atomic<int64_t> counts[2] = { 0, 0 };
+	};
+
+	class ReadGuard {
+	public:
+		explicit ReadGuard(const SnapshotSearchServer& server);
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+		~ReadGuard();
+
+		const SearchServer& Get() const;
+
+	private:
+		const SnapshotSearchServer& server_;
+		ReaderStripe& stripe_;
+		int replica_;
+	};
+
+	std::unique_ptr<SearchServer> replicas_[2];
+	std::atomic<int> published_replica_{ 0 };
+	// The unpublished replica missed an update and must be rebuilt before the next one
+	bool is_hidden_replica_stale_ = false;
+	mutable ReaderStripe reader_stripes_[READER_STRIPE_COUNT];
+	std::mutex write_mutex_;
+
+	ReaderStripe& GetReaderStripe() const;
+	void WaitForReaders(int replica) const;
+	void RebuildHiddenReplica();
+	static void CompactIfDue(SearchServer& replica);
+};
+
+template <typename StringContainer>
+SnapshotSearchServer::SnapshotSearchServer(const StringContainer& stop_words) {
+	for (auto& replica : replicas_) {
+		replica = std::make_unique<SearchServer>(stop_words);
+	}
+}
+
+template <typename Function>
+auto SnapshotSearchServer::Read(Function function) const {
+	const ReadGuard guard(*this);
+	return function(guard.Get());
+}
+
+template <typename... Args>
+std::vector<Document> SnapshotSearchServer::FindTopDocuments(const Args&... args) const {
+	return Read([&](const SearchServer& server) {
+		return server.FindTopDocuments(args...);
+	});
+}
+
+template <typename Function>
+void SnapshotSearchServer::Write(Function function) {
+	std::lock_guard guard(write_mutex_);
+	if (is_hidden_replica_stale_) {
+		RebuildHiddenReplica();
+	}
+	const int hidden = 1 - published_replica_.load();
+	std::exception_ptr error;
+	try {
+		function(*replicas_[hidden]);
+		CompactIfDue(*replicas_[hidden]);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	published_replica_.store(hidden);
+	WaitForReaders(1 - hidden);
+	std::exception_ptr second_error;
+	try {
+		function(*replicas_[1 - hidden]);
+		CompactIfDue(*replicas_[1 - hidden]);
+	}
+	catch (...) {
+		second_error = std::current_exception();
+	}
+	// A deterministic function fails the same way on both replicas, otherwise they differ
+	if (!error != !second_error) {
+		is_hidden_replica_stale_ = true;
+		try {
+			RebuildHiddenReplica();
+		}
+		catch (...) {
+			// Left stale, so the next Write retries before changing anything
+		}
+		error = error ? error : second_error;
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
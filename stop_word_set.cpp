@@ -0,0 +1,92 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+StopWordSet::StopWordSet(const set<string, less<>>& words) {
+	size_t slot_count = 1;
+	while (slot_count < 2 * words.size()) {
+		slot_count *= 2;
+	}
+	slots_.resize(slot_count);
+	slot_mask_ = slot_count - 1;
+
+	word_offsets_.reserve(words.size() + 1);
+	for (const string& word : words) {
+		const uint32_t offset = static_cast<uint32_t>(text_.size());
+		word_offsets_.push_back(offset);
+		text_ += word;
+		if (word.empty()) {
+			continue;
+		}
+
+		lengths_ |= uint64_t{ 1 } << min(static_cast<uint32_t>(word.size()), MAX_LENGTH_BIT);
+		const auto first_byte = static_cast<unsigned char>(word[0]);
+		first_bytes_[first_byte / 64] |= uint64_t{ 1 } << (first_byte % 64);
+
+		const uint32_t hash = Hash(word);
+		size_t slot = hash & slot_mask_;
+		while (slots_[slot].length != 0) {
+			slot = (slot + 1) & slot_mask_;
+		}
+		slots_[slot] = { hash, static_cast<uint32_t>(word.size()), offset };
+	}
+	word_offsets_.push_back(static_cast<uint32_t>(text_.size()));
+}
+
+bool StopWordSet::Contains(string_view word) const {
+	if (!MayContain(word)) {
+		return false;
+	}
+	const uint32_t hash = Hash(word);
+	for (size_t slot = hash & slot_mask_; slots_[slot].length != 0; slot = (slot + 1) & slot_mask_) {
+		const Slot& entry = slots_[slot];
+		if (entry.hash == hash && entry.length == word.size() && text_.compare(entry.offset, entry.length, word) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t StopWordSet::size() const {
+	return word_offsets_.empty() ? 0 : word_offsets_.size() - 1;
+}
+
+bool StopWordSet::empty() const {
+	return size() == 0;
+}
+
+vector<string_view> StopWordSet::GetWords() const {
+	vector<string_view> words;
+	words.reserve(size());
+	for (size_t i = 0; i < size(); ++i) {
+		words.push_back(string_view(text_).substr(word_offsets_[i], word_offsets_[i + 1] - word_offsets_[i]));
+	}
+	return words;
+}
+
+uint32_t StopWordSet::Hash(string_view word) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const char c : word) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+	}
+	return hash;
+}
+
+bool StopWordSet::MayContain(string_view word) const {
+	if (word.empty()) {
+		return false;
+	}
+	if ((lengths_ >> min(static_cast<uint32_t>(word.size()), MAX_LENGTH_BIT) & 1) == 0) {
+		return false;
+	}
+	const auto first_byte = static_cast<unsigned char>(word[0]);
+	return (first_bytes_[first_byte / 64] >> (first_byte % 64) & 1) != 0;
+}
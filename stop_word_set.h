@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of stop words in one string plus an open addressing table of offsets.
+// Lookups are rejected early by a bitmap of word lengths and one of first bytes,
+// so most document words never reach the table.
+class StopWordSet {
+public:
+	StopWordSet() = default;
+	explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+	bool Contains(std::string_view word) const;
+
+	size_t size() const;
+	bool empty() const;
+
+	// In ascending order
+	std::vector<std::string_view> GetWords() const;
+
+private:
+	struct Slot {
+		uint32_t hash = 0;
+		uint32_t length = 0;
+		uint32_t offset = 0;
+	};
+
+	static constexpr uint32_t MAX_LENGTH_BIT = 63;
+
+	std::string text_;
+	std::vector<uint32_t> word_offsets_;
+	std::vector<Slot> slots_;
+	size_t slot_mask_ = 0;
+	// Bit min(length, MAX_LENGTH_BIT) is set for every word length
+	uint64_t lengths_ = 0;
+	std::array<uint64_t, 4> first_bytes_ = {};
+
+	static uint32_t Hash(std::string_view word);
+	bool MayContain(std::string_view word) const;
+};
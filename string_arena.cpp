@@ -0,0 +1,30 @@
+#include "string_arena.h"
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+
+using namespace std;
+
+string_view StringArena::Add(string_view text) {
+	if (block_used_ + text.size() > block_capacity_ || blocks_.empty()) {
+		// Long strings get a block of their own
+		block_capacity_ = max(BLOCK_SIZE, text.size());
+		blocks_.push_back(make_unique<char[]>(block_capacity_));
+		block_used_ = 0;
+		capacity_ += block_capacity_;
+	}
+	char* data = blocks_.back().get() + block_used_;
+	copy(text.begin(), text.end(), data);
+	block_used_ += text.size();
+	size_ += text.size();
+	return { data, text.size() };
+}
+
+size_t StringArena::GetSize() const {
+	return size_;
+}
+
+size_t StringArena::GetCapacity() const {
+	return capacity_;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for many small strings. Views returned by Add stay valid
+// until the arena is destroyed, so the arena can't be copied.
+class StringArena {
+public:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	StringArena() = default;
+	StringArena(const StringArena&) = delete;
+	StringArena& operator=(const StringArena&) = delete;
+	StringArena(StringArena&&) noexcept = default;
+	StringArena& operator=(StringArena&&) noexcept = default;
+
+	std::string_view Add(std::string_view text);
+
+	size_t GetSize() const;
+	size_t GetCapacity() const;
+
+private:
+	std::vector<std::unique_ptr<char[]>> blocks_;
+	size_t block_used_ = 0;
+	size_t block_capacity_ = 0;
+	size_t size_ = 0;
+	size_t capacity_ = 0;
+};
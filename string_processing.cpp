@@ -53,9 +53,8 @@ void FindTopDocuments(const SearchServer& search_server, const string& raw_query
 void MatchDocuments( SearchServer& search_server, string_view query) {
 	try {
 		cout << "Матчинг документов по запросу: "s << query << endl;
-		for (auto it = search_server.begin(); it != search_server.end(); it++) {
-			const auto [words, status] = search_server.MatchDocument(query, *it);
-			PrintMatchDocumentResult(*it, words, status);
+		for (const MatchedDocument& document : search_server.MatchDocuments(query)) {
+			PrintMatchDocumentResult(document.id, document.words, document.status);
 		}
 	}
 	catch (const exception& e) {
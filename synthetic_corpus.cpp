@@ -0,0 +1,139 @@
+#include "synthetic_corpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Bijective base-26 skipping the one-letter numbers: distinct ranks give distinct words
+string MakeWord(size_t rank) {
+	string word;
+	for (size_t value = rank + 27; value > 0; value /= 26) {
+		--value;
+		word.push_back(static_cast<char>('a' + value % 26));
+	}
+	return word;
+}
+
+// Whole exponents take repeated multiplication: unlike pow, IEEE requires every product
+// to be rounded the same way, so the weights do not depend on the math library
+double RaiseToPower(double base, double exponent) {
+	if (exponent < 0.0 || exponent > 64.0 || exponent != floor(exponent)) {
+		return pow(base, exponent);
+	}
+	double result = 1.0;
+	for (int i = 0; i < static_cast<int>(exponent); ++i) {
+		result *= base;
+	}
+	return result;
+}
+
+}
+
+SyntheticCorpus::SyntheticCorpus(const SyntheticCorpusOptions& options)
+	: options_(options), generator_(options.seed) {
+	if (options_.vocabulary_size == 0 || options_.words_per_document == 0) {
+		throw invalid_argument("synthetic corpus needs a vocabulary and non-empty documents");
+	}
+
+	vocabulary_.reserve(options_.vocabulary_size);
+	rank_weights_.reserve(options_.vocabulary_size);
+	double total_weight = 0.0;
+	for (size_t rank = 0; rank < options_.vocabulary_size; ++rank) {
+		vocabulary_.push_back(MakeWord(rank));
+		total_weight += 1.0 / RaiseToPower(static_cast<double>(rank + 1), options_.zipf_exponent);
+		rank_weights_.push_back(total_weight);
+	}
+
+	texts_.reserve(options_.document_count);
+	statuses_.reserve(options_.document_count);
+	ratings_.reserve(options_.document_count);
+	vector<size_t> ranks;
+	for (size_t i = 0; i < options_.document_count; ++i) {
+		ranks.clear();
+		if (!texts_.empty() && NextUniform() < options_.duplicate_share) {
+			// Reverse the words of an earlier document: a new text with the same word set
+			const string& original = texts_[NextRandom() % texts_.size()];
+			string text;
+			for (size_t end = original.size(); end > 0;) {
+				const size_t begin = original.rfind(' ', end - 1);
+				const size_t word_begin = begin == original.npos ? 0 : begin + 1;
+				text.append(original, word_begin, end - word_begin).push_back(' ');
+				end = begin == original.npos ? 0 : begin;
+			}
+			text.pop_back();
+			texts_.push_back(move(text));
+		}
+		else {
+			string text;
+			for (size_t j = 0; j < options_.words_per_document; ++j) {
+				text += vocabulary_[NextRank()];
+				text.push_back(' ');
+			}
+			text.pop_back();
+			texts_.push_back(move(text));
+		}
+		statuses_.push_back(static_cast<DocumentStatus>(NextRandom() % 3));
+		ratings_.push_back(static_cast<int>(NextRandom() % 11) - 5);
+	}
+}
+
+const vector<string>& SyntheticCorpus::GetVocabulary() const {
+	return vocabulary_;
+}
+
+const vector<string>& SyntheticCorpus::GetTexts() const {
+	return texts_;
+}
+
+vector<RawDocument> SyntheticCorpus::GetDocuments() const {
+	vector<RawDocument> documents;
+	documents.reserve(texts_.size());
+	for (size_t i = 0; i < texts_.size(); ++i) {
+		documents.push_back({ static_cast<int>(i), texts_[i], statuses_[i], { ratings_[i] } });
+	}
+	return documents;
+}
+
+vector<string> SyntheticCorpus::GenerateQueries(size_t query_count) {
+	vector<string> queries;
+	queries.reserve(query_count);
+	for (size_t i = 0; i < query_count; ++i) {
+		string query;
+		for (size_t j = 0; j < options_.query_word_count; ++j) {
+			query += vocabulary_[NextRank()];
+			query.push_back(' ');
+		}
+		if (NextUniform() < options_.minus_word_share) {
+			query.push_back('-');
+			query += vocabulary_[NextRank()];
+		}
+		else if (!query.empty()) {
+			query.pop_back();
+		}
+		queries.push_back(move(query));
+	}
+	return queries;
+}
+
+uint64_t SyntheticCorpus::NextRandom() {
+	return generator_();
+}
+
+double SyntheticCorpus::NextUniform() {
+	// The top 53 bits make an exact double in [0, 1); distributions of the standard
+	// library differ between implementations and would break reproducibility
+	return static_cast<double>(NextRandom() >> 11) * 0x1.0p-53;
+}
+
+size_t SyntheticCorpus::NextRank() {
+	const double target = NextUniform() * rank_weights_.back();
+	const auto it = upper_bound(rank_weights_.begin(), rank_weights_.end(), target);
+	return min(static_cast<size_t>(it - rank_weights_.begin()), rank_weights_.size() - 1);
+}
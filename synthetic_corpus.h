@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+struct SyntheticCorpusOptions {
+	size_t document_count = 10000;
+	size_t vocabulary_size = 20000;
+	size_t words_per_document = 50;
+	size_t query_word_count = 3;
+	// Skew of word ranks: the word of rank r is drawn with weight 1 / r^zipf_exponent
+	double zipf_exponent = 1.0;
+	// Share of queries that get one minus word
+	double minus_word_share = 0.2;
+	// Share of documents that copy the words of an earlier document in another order
+	double duplicate_share = 0.05;
+	uint64_t seed = 42;
+};
+
+// Documents and queries drawn from one Zipf-distributed vocabulary. Only mt19937_64 output
+// is used for sampling, so the same options give the same corpus on every platform as long
+// as zipf_exponent is a whole number; other exponents go through pow, whose last bit may
+// differ between math libraries and shift a few ranks
+class SyntheticCorpus {
+public:
+	explicit SyntheticCorpus(const SyntheticCorpusOptions& options);
+
+	const std::vector<std::string>& GetVocabulary() const;
+	const std::vector<std::string>& GetTexts() const;
+
+	// Ids are the text indices; statuses and ratings are random too. The views point into this corpus
+	std::vector<RawDocument> GetDocuments() const;
+
+	// Every call continues the same random sequence, so a second call gives new queries
+	std::vector<std::string> GenerateQueries(size_t query_count);
+
+private:
+	SyntheticCorpusOptions options_;
+	std::vector<std::string> vocabulary_;
+	// Cumulative weights of the word ranks
+	std::vector<double> rank_weights_;
+	std::vector<std::string> texts_;
+	std::vector<DocumentStatus> statuses_;
+	std::vector<int> ratings_;
+	std::mt19937_64 generator_;
+
+	uint64_t NextRandom();
+	double NextUniform();
+	size_t NextRank();
+};
@@ -2,13 +2,34 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <set>
+#include <atomic>
+#include <thread>
 #include <exception>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+#include <limits>
 
 #include "document.h"
 #include "search_server.h"
 #include "paginator.h"
 #include "request_queue.h"
 #include "remove_duplicates.h"
+#include "process_queries.h"
+#include "posting_list.h"
+#include "sharded_search_server.h"
+#include "corpus_loader.h"
+#include "tokenizer.h"
+#include "stop_word_set.h"
+#include "thread_pool.h"
+#include "snapshot_search_server.h"
+#include "latency_histogram.h"
+#include "synthetic_corpus.h"
+#include "benchmark.h"
 
 using namespace std;
 
@@ -421,6 +442,42 @@ void TestRequestQueue() {
 
 }
 
+void TestConcurrentRequestQueue() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 100);
+	RequestQueue request_queue(server, 500);
+
+	vector<thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&request_queue, t] {
+			for (int i = 0; i < 1000; ++i) {
+				request_queue.AddFindRequest(t % 2 == 0 ? "cat"s : "missing"s);
+			}
+		});
+	}
+	for (thread& worker : threads) {
+		worker.join();
+	}
+	const RequestStats stats = request_queue.GetStats();
+	ASSERT_EQUAL(stats.request_count, 500u);
+	ASSERT_EQUAL(stats.no_result_count, static_cast<size_t>(request_queue.GetNoResultRequests()));
+	ASSERT(stats.no_result_count <= 500u);
+	ASSERT(stats.average_latency_ns > 0);
+	ASSERT(stats.first_request_ns > 0 && stats.first_request_ns <= stats.last_request_ns);
+
+	for (int i = 0; i < 500; ++i) {
+		request_queue.AddFindRequest("missing"s);
+	}
+	ASSERT_EQUAL_HINT(request_queue.GetNoResultRequests(), 500, "Window must hold only the last requests"s);
+	const RequestStats window_stats = request_queue.GetStats();
+	ASSERT_HINT(window_stats.first_request_ns >= stats.last_request_ns, "The window must start at its oldest request"s);
+	ASSERT(window_stats.first_request_ns <= window_stats.last_request_ns);
+	for (int i = 0; i < 100; ++i) {
+		request_queue.AddFindRequest("cat"s, DocumentStatus::IRRELEVANT);
+	}
+	ASSERT_EQUAL(request_queue.GetNoResultRequests(), 400);
+}
+
 void TestGetWordFrequencies() {
 	map<string, double> answer = { {"funny"s, 0.25}, {"nasty"s, 0.25}, {"pet"s, 0.25}, {"rat"s, 0.25} };
 	SearchServer server("and with"s);
@@ -467,6 +524,884 @@ void TestDeleteDuplicate() {
 	}
 }
 
+void TestFindDuplicateDocuments() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 1000);
+	server.RemoveDocument(3);
+
+	set<set<string_view>> word_sets;
+	vector<int> expected;
+	for (const int document_id : server) {
+		set<string_view> words;
+		for (const auto& [word, _] : server.GetWordFrequencies(document_id)) {
+			words.insert(word);
+		}
+		if (!word_sets.insert(words).second) {
+			expected.push_back(document_id);
+		}
+	}
+	ASSERT(!expected.empty());
+	ASSERT_EQUAL(server.FindDuplicateDocuments(), expected);
+
+	RemoveDuplicates(server, false);
+	ASSERT_EQUAL(server.GetDocumentCount(), static_cast<int>(word_sets.size()));
+	ASSERT(server.FindDuplicateDocuments().empty());
+}
+
+void TestPostingsOrder() {
+	SearchServer server("and with"s);
+	server.AddDocument(7, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "curly dog"s, DocumentStatus::ACTUAL, { 2 });
+	server.AddDocument(5, "curly hamster"s, DocumentStatus::ACTUAL, { 3 });
+
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("curly"s).size(), 3u, "Must find documents added out of id order"s);
+	ASSERT_EQUAL_HINT(get<0>(server.MatchDocument("curly dog"s, 2)).size(), 2u, "Must match document inserted before others"s);
+
+	server.RemoveDocument(5);
+	vector<int> found_docs_id;
+	for (const auto& doc : server.FindTopDocuments("curly"s)) {
+		found_docs_id.push_back(doc.id);
+	}
+	ASSERT_EQUAL_HINT(found_docs_id, vector<int>({ 2, 7 }), "Removed document must leave postings"s);
+	ASSERT_HINT(get<0>(server.MatchDocument("hamster"s, 7)).empty(), "Removed document must not match"s);
+}
+
+void TestTermDictionary() {
+	SearchServer server("and with"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "nasty dog with curly hair"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+
+	vector<string_view> words;
+	{
+		const string query = "rat nasty unknown -dog"s;
+		words = get<0>(server.MatchDocument(query, 1));
+	}
+	ASSERT_EQUAL_HINT(words, vector<string_view>({ "nasty"sv, "rat"sv }), "Matched words must outlive the query"s);
+
+	server.RemoveDocument(1);
+	ASSERT_HINT(server.FindTopDocuments("rat"s).empty(), "Term without documents must not be found"s);
+	ASSERT_HINT(server.FindTopDocuments("unknown"s).empty(), "Unknown term must not be found"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("nasty"s).size(), 1u, "Must be find one document"s);
+}
+
+void TestMaxResultCount() {
+	SearchServer server("и в на"s);
+	server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+	server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+	server.AddDocument(3, "ухоженный скворец евгений"s, DocumentStatus::BANNED, { 9 });
+
+	const auto top_two = server.FindTopDocuments("пушистый ухоженный кот"s, DocumentStatus::ACTUAL, 2);
+	vector<int> found_docs_id;
+	for (const auto& doc : top_two) {
+		found_docs_id.push_back(doc.id);
+	}
+	ASSERT_EQUAL_HINT(found_docs_id, vector<int>({ 1, 0 }), "Must return two best documents in order"s);
+
+	const auto top_par = server.FindTopDocuments(execution::par, "пушистый ухоженный кот"s, DocumentStatus::ACTUAL, 2);
+	ASSERT_EQUAL_HINT(top_par.size(), 2u, "Parallel search must respect result count"s);
+	ASSERT_EQUAL_HINT(top_par[1].id, 0, "Parallel search must keep the same order"s);
+
+	ASSERT_HINT(server.FindTopDocuments("пушистый ухоженный кот"s, DocumentStatus::ACTUAL, 0).empty(), "Zero result count must return nothing"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("пушистый ухоженный кот"s, DocumentStatus::ACTUAL, 100).size(), 3u, "Must return all matched documents"s);
+
+	// The limit is only a bound: nothing may be allocated in proportion to it
+	const size_t huge_count = numeric_limits<size_t>::max();
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("пушистый ухоженный кот"s, DocumentStatus::ACTUAL, huge_count).size(), 3u,
+		"Huge result count must return all matched documents"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, "пушистый ухоженный кот"s, DocumentStatus::ACTUAL, huge_count).size(), 3u,
+		"Parallel search must accept a huge result count"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments(search_policy::max_score, "пушистый ухоженный кот"s, DocumentStatus::ACTUAL, huge_count).size(), 3u,
+		"Pruned search must accept a huge result count"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("кот"s, DocumentStatus::ACTUAL, size_t{ 1 } << 40).size(), 2u,
+		"Huge result count must return all matched documents"s);
+}
+
+void TestMaxScorePolicy() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 500);
+
+	for (const string& query : { "cat pigeon"s, "cat dog curly"s, "cat hat -white"s, "pigeon eyes big -dog"s, "unknown"s }) {
+		for (const size_t max_result_count : { 1u, 5u, 50u }) {
+			const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_result_count);
+			const auto pruned = server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, max_result_count);
+			ASSERT_EQUAL_HINT(pruned.size(), expected.size(), "Pruned search must find the same number of documents"s);
+			for (size_t i = 0; i < expected.size(); ++i) {
+				ASSERT_EQUAL_HINT(pruned[i].id, expected[i].id, "Pruned search must keep the same order"s);
+				ASSERT_HINT(abs(pruned[i].relevance - expected[i].relevance) < EPSILON, "Pruned search must keep relevance"s);
+			}
+		}
+	}
+}
+
+void TestParallelFind() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 500);
+	server.RemoveDocument(execution::par, 17);
+	server.RemoveDocument(250);
+
+	const auto odd_rating = []([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus status, int rating) {
+		return rating % 2 == 1;
+	};
+	for (const string& query : { "cat pigeon"s, "cat hat -white"s, "pigeon eyes big -dog -tail"s }) {
+		const auto expected = server.FindTopDocuments(query, odd_rating, 20);
+		const auto found = server.FindTopDocuments(execution::par, query, odd_rating, 20);
+		ASSERT_EQUAL_HINT(found.size(), expected.size(), "Parallel search must find the same number of documents"s);
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQUAL_HINT(found[i].id, expected[i].id, "Parallel search must keep the same order"s);
+			ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) < EPSILON, "Parallel search must keep relevance"s);
+		}
+	}
+}
+
+void TestRelevanceAfterRemove() {
+	SearchServer server("и в на"s);
+	server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+	server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+	server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+	server.RemoveDocument(1);
+
+	SearchServer expected_server("и в на"s);
+	expected_server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+	expected_server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+
+	const auto found_docs = server.FindTopDocuments("пушистый ухоженный кот"s);
+	const auto expected_docs = expected_server.FindTopDocuments("пушистый ухоженный кот"s);
+	ASSERT_EQUAL_HINT(found_docs.size(), expected_docs.size(), "Must find the same documents"s);
+	for (size_t i = 0; i < found_docs.size(); ++i) {
+		ASSERT_EQUAL_HINT(found_docs[i].id, expected_docs[i].id, "Must find the same documents"s);
+		ASSERT_HINT(abs(found_docs[i].relevance - expected_docs[i].relevance) < EPSILON, "IDF must follow removed documents"s);
+	}
+}
+
+void TestPostingListCompression() {
+	PostingList postings;
+	vector<int> expected;
+	for (int document_id = 0; document_id < 5000; document_id += 1 + document_id % 7) {
+		postings.Add(document_id, 1 + document_id % 300, 0.5);
+		expected.push_back(document_id);
+	}
+	ASSERT_EQUAL_HINT(postings.size(), expected.size(), "Every posting must be counted"s);
+
+	vector<int> decoded;
+	PostingList::Cursor decoder(postings);
+	for (decoder.Next(); !decoder.IsEnd(); decoder.Next()) {
+		ASSERT_EQUAL_HINT(decoder.GetTermCount(), static_cast<uint32_t>(1 + decoder.GetDocumentId() % 300), "Term count must survive encoding"s);
+		decoded.push_back(decoder.GetDocumentId());
+	}
+	ASSERT_EQUAL_HINT(decoded, expected, "Postings must decode in order"s);
+
+	PostingList::Cursor cursor(postings);
+	ASSERT_HINT(cursor.IsEnd(), "New cursor must stand before the first posting"s);
+	cursor.NextGeq(2500);
+	ASSERT_EQUAL_HINT(cursor.GetDocumentId(), *lower_bound(expected.begin(), expected.end(), 2500), "Cursor must skip to the first document not less"s);
+	ASSERT_HINT(postings.Contains(expected[100]) && !postings.Contains(expected[100] + 1), "Contains must find only stored documents"s);
+	ASSERT_HINT(postings.GetMemoryUsage() < expected.size() * sizeof(int) * 2, "Postings must be compressed"s);
+}
+
+void TestTokenize() {
+	const string alphabet = "ab -\x12\xC3"s;
+	vector<string_view> words;
+	for (int seed = 0; seed < 2000; ++seed) {
+		string text;
+		for (int i = 0; i < seed % 97; ++i) {
+			text += alphabet[(seed * 31 + i * i * 7) % (i % 5 == 0 ? alphabet.size() : 3)];
+		}
+
+		vector<string_view> expected;
+		bool expected_valid = true;
+		for (string_view rest = text; !rest.empty();) {
+			const size_t space = rest.find(' ');
+			expected.push_back(rest.substr(0, space));
+			expected_valid = expected_valid && SearchServer::IsValidWord(expected.back());
+			if (space == rest.npos) {
+				break;
+			}
+			rest.remove_prefix(space + 1);
+			if (rest.empty()) {
+				expected.push_back(rest);
+			}
+		}
+
+		ASSERT_EQUAL_HINT(Tokenize(text, words), expected_valid, "Tokenizer must find control characters"s);
+		ASSERT_EQUAL_HINT(words, expected, "Tokenizer must split like find(' ')"s);
+	}
+}
+
+void TestStopWordSet() {
+	set<string, less<>> words;
+	for (int i = 0; i < 500; ++i) {
+		words.insert("w"s + to_string(i * 3));
+	}
+	words.insert(string(100, 'x'));
+	words.insert("\xC3\xA9t\xC3\xA9"s);
+	const StopWordSet stop_words(words);
+
+	ASSERT_EQUAL(stop_words.size(), words.size());
+	ASSERT_EQUAL(stop_words.GetWords(), vector<string_view>(words.begin(), words.end()));
+	for (int i = 0; i < 1500; ++i) {
+		ASSERT_EQUAL_HINT(stop_words.Contains("w"s + to_string(i)), i % 3 == 0, "Only stop words must be found"s);
+	}
+	ASSERT(stop_words.Contains(string(100, 'x')));
+	ASSERT(!stop_words.Contains(string(99, 'x') + "y"s));
+	ASSERT(stop_words.Contains("\xC3\xA9t\xC3\xA9"sv));
+	ASSERT(!stop_words.Contains(""sv));
+	ASSERT(!StopWordSet().Contains("w0"sv));
+}
+
+void TestThreadPool() {
+	ThreadPool thread_pool(4);
+	ASSERT_EQUAL(thread_pool.GetThreadCount(), 4u);
+
+	vector<vector<int>> values(50, vector<int>(100));
+	thread_pool.ParallelFor(values.size(), [&](size_t i) {
+		thread_pool.ParallelFor(values[i].size(), [&](size_t j) {
+			values[i][j] = static_cast<int>(i * j);
+		});
+	});
+	for (size_t i = 0; i < values.size(); ++i) {
+		ASSERT_EQUAL_HINT(accumulate(values[i].begin(), values[i].end(), 0), static_cast<int>(i * 4950), "Nested loops must run every call"s);
+	}
+
+	try {
+		thread_pool.ParallelFor(100, [](size_t i) {
+			if (i == 37) {
+				throw out_of_range("37"s);
+			}
+		});
+		ASSERT_HINT(false, "Exception must reach the caller"s);
+	}
+	catch (const out_of_range& e) {
+		ASSERT_EQUAL(e.what(), "37"s);
+	}
+
+	ThreadPool::GetDefault();
+	try {
+		ThreadPool::SetDefaultThreadCount(2);
+		ASSERT_HINT(false, "Running default pool can't be resized"s);
+	}
+	catch (const logic_error&) {
+	}
+}
+
+void TestQueryCache() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 300);
+	const auto expected = server.FindTopDocuments("cat dog -hat"s);
+	server.EnableQueryCache(100);
+
+	const auto first = server.FindTopDocuments("cat dog -hat"s);
+	const auto second = server.FindTopDocuments(execution::par, "dog cat cat and -hat"s);
+	ASSERT_EQUAL(server.GetQueryCacheStats().miss_count, 1u);
+	ASSERT_EQUAL_HINT(server.GetQueryCacheStats().hit_count, 1u, "Normalized query must hit the cache"s);
+	for (const auto* found : { &first, &second }) {
+		ASSERT_EQUAL(found->size(), expected.size());
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQUAL(found->at(i).id, expected[i].id);
+		}
+	}
+
+	server.FindTopDocuments("cat dog -hat"s, DocumentStatus::BANNED);
+	server.FindTopDocuments("cat dog -hat"s, DocumentStatus::ACTUAL, 10);
+	ASSERT_EQUAL_HINT(server.GetQueryCacheStats().miss_count, 3u, "Status and result count must be part of the key"s);
+
+	server.AddDocument(1000, "dog"s, DocumentStatus::ACTUAL, { 100 });
+	const auto after_add = server.FindTopDocuments("cat dog -hat"s);
+	ASSERT_EQUAL_HINT(after_add.front().id, 1000, "Adding a document must invalidate the cache"s);
+	server.RemoveDocument(1000);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("cat dog -hat"s).front().id, expected.front().id, "Removing a document must invalidate the cache"s);
+	ASSERT_EQUAL(server.GetQueryCacheStats().hit_count, 1u);
+
+	server.EnableQueryCache(0);
+	server.FindTopDocuments("cat dog -hat"s);
+	ASSERT_EQUAL(server.GetQueryCacheStats().hit_count, 0u);
+}
+
+void TestSnapshotSearchServer() {
+	SnapshotSearchServer server("and with"s);
+	AddRandomDocuments(server, 200);
+	ASSERT_EQUAL(server.GetDocumentCount(), 200);
+
+	atomic<bool> is_writing = true;
+	atomic<int> read_count = 0;
+	vector<thread> readers;
+	for (int i = 0; i < 4; ++i) {
+		readers.emplace_back([&] {
+			// Every reader reads at least once, even when the writer finishes first
+			do {
+				// Each update adds and removes a pair of documents, so counts stay even
+				const auto [count, found] = server.Read([](const SearchServer& replica) {
+					return pair{ replica.GetDocumentCount(), replica.FindTopDocuments("cat dog"s) };
+				});
+				ASSERT_HINT(count % 2 == 0 && count >= 200, "Readers must see whole updates"s);
+				ASSERT(!found.empty());
+				++read_count;
+			} while (is_writing);
+		});
+	}
+	for (int document_id = 1000; document_id < 1200; document_id += 2) {
+		server.AddDocuments({ { document_id, "cat dog"sv, DocumentStatus::ACTUAL, { 1 } }, { document_id + 1, "curly dog"sv, DocumentStatus::ACTUAL, { 2 } } });
+		if (document_id % 4 == 0) {
+			server.Write([document_id](SearchServer& replica) {
+				replica.RemoveDocument(document_id);
+				replica.RemoveDocument(document_id + 1);
+			});
+		}
+	}
+	is_writing = false;
+	for (thread& reader : readers) {
+		reader.join();
+	}
+	ASSERT(read_count > 0);
+
+	ASSERT_EQUAL(server.GetDocumentCount(), 300);
+	ASSERT_EQUAL(get<0>(server.MatchDocument("curly tail"s, 1003)), vector<string>{ "curly"s });
+	ASSERT(server.GetWordFrequencies(1000).empty());
+	try {
+		server.AddDocument(1002, "big cat"s, DocumentStatus::ACTUAL, { 1 });
+		ASSERT_HINT(false, "Existing id must be rejected"s);
+	}
+	catch (const invalid_argument&) {
+	}
+	ASSERT_EQUAL(server.GetDocumentCount(), 300);
+	ASSERT_EQUAL(server.FindTopDocuments(execution::par, "cat"s, DocumentStatus::ACTUAL, 1000).size(),
+		server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 1000).size());
+
+	// The update fails on the second replica only, so that one is rebuilt
+	int call_count = 0;
+	try {
+		server.Write([&call_count](SearchServer& replica) {
+			if (++call_count == 2) {
+				throw runtime_error("second replica failed"s);
+			}
+			replica.AddDocument(2000, "lonely cat"s, DocumentStatus::ACTUAL, { 1 });
+		});
+		ASSERT_HINT(false, "Exceptions from the second replica must propagate"s);
+	}
+	catch (const runtime_error&) {
+	}
+	ASSERT_EQUAL(server.GetDocumentCount(), 301);
+	server.AddDocument(2001, "lonely dog"s, DocumentStatus::ACTUAL, { 1 });
+	ASSERT_EQUAL(server.GetDocumentCount(), 302);
+	server.AddDocument(2002, "lonely hat"s, DocumentStatus::ACTUAL, { 1 });
+	ASSERT_EQUAL(server.GetDocumentCount(), 303);
+	ASSERT_EQUAL(server.FindTopDocuments("lonely"s).size(), 3u);
+
+	// The first replica fails after the removal, before Write compacts it, while the
+	// second one completes and compacts: the rebuilt replica must keep the dead terms
+	SnapshotSearchServer small_server("and"s);
+	small_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+	small_server.AddDocument(2, "extraordinarily"s, DocumentStatus::ACTUAL, { 1 });
+	call_count = 0;
+	try {
+		small_server.Write([&call_count](SearchServer& replica) {
+			replica.RemoveDocument(2);
+			if (++call_count == 1) {
+				throw runtime_error("first replica failed"s);
+			}
+		});
+		ASSERT_HINT(false, "Exceptions from the first replica must propagate"s);
+	}
+	catch (const runtime_error&) {
+	}
+	vector<bool> is_compaction_due;
+	vector<string> indexes;
+	small_server.Write([&](SearchServer& replica) {
+		is_compaction_due.push_back(replica.IsCompactionDue());
+		ostringstream index;
+		replica.Save(index);
+		indexes.push_back(index.str());
+	});
+	ASSERT_EQUAL_HINT(is_compaction_due, (vector<bool>{ true, true }), "Rebuilt replica must keep the compaction schedule"s);
+	ASSERT_HINT(indexes[0] == indexes[1], "Rebuilt replica must keep term ids and dead terms"s);
+}
+
+void TestLatencyHistogram() {
+	latency::Reset();
+	for (uint64_t duration_ns = 1; duration_ns <= 1000000; ++duration_ns) {
+		latency::Record(LatencyStage::TOP_K, duration_ns);
+	}
+	const LatencySummary summary = latency::GetSummary(LatencyStage::TOP_K);
+	ASSERT_EQUAL(summary.count, 1000000u);
+	ASSERT_EQUAL(summary.max_ns, 1000000u);
+	for (const auto& [percentile, expected] : { pair{ summary.p50_ns, 500000.0 }, pair{ summary.p99_ns, 990000.0 }, pair{ summary.p999_ns, 999000.0 } }) {
+		ASSERT_HINT(percentile >= expected && percentile <= expected * 1.07, "Percentiles must be within a bucket"s);
+	}
+	thread([] {
+		latency::Record(LatencyStage::TOP_K, 2000000);
+	}).join();
+	ASSERT_EQUAL_HINT(latency::GetSummary(LatencyStage::TOP_K).count, 1000001u, "Counts must outlive their threads"s);
+	ASSERT_EQUAL(latency::GetSummary(LatencyStage::TOP_K).max_ns, 2000000u);
+
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 100);
+	latency::Reset();
+	server.FindTopDocuments("cat -dog"s);
+	ASSERT_EQUAL_HINT(latency::GetSummary(LatencyStage::PARSE).count, 0u, "Tracking must be off by default"s);
+
+	latency::SetEnabled(true);
+	server.FindTopDocuments("cat -dog"s);
+	server.FindTopDocuments(execution::par, "cat -dog"s);
+	server.AddDocument(1000, "big cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.MatchDocument("cat"s, 1000);
+	server.RemoveDocument(1000);
+	latency::SetEnabled(false);
+	for (const LatencyStage stage : { LatencyStage::PARSE, LatencyStage::MINUS_WORDS, LatencyStage::POSTINGS, LatencyStage::FILTER,
+		LatencyStage::TOP_K, LatencyStage::ADD_DOCUMENT, LatencyStage::REMOVE_DOCUMENT, LatencyStage::MATCH_DOCUMENT }) {
+		ASSERT_HINT(latency::GetSummary(stage).count > 0, "Every stage must be recorded"s);
+	}
+	ASSERT_EQUAL(latency::GetSummary(LatencyStage::PARSE).count, 2u);
+	for (const LatencyStage stage : { LatencyStage::MINUS_WORDS, LatencyStage::POSTINGS, LatencyStage::FILTER, LatencyStage::TOP_K }) {
+		ASSERT_EQUAL_HINT(latency::GetSummary(stage).count, 2u, "Parallel searches must record each stage once"s);
+	}
+	latency::Reset();
+}
+
+void TestMatchDocuments() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 300);
+	server.RemoveDocument(5);
+
+	for (const string& query : { "cat curly -dog"s, "tail nasty big"s, "missing -cat"s, "-missing"s }) {
+		const vector<MatchedDocument> matched = server.MatchDocuments(query);
+		ASSERT_EQUAL(matched.size(), static_cast<size_t>(server.GetDocumentCount()));
+		auto document_id = server.begin();
+		for (const MatchedDocument& document : matched) {
+			ASSERT_EQUAL(document.id, *document_id++);
+			const auto [words, status] = server.MatchDocument(query, document.id);
+			ASSERT(document.words == words);
+			ASSERT(document.status == status);
+		}
+
+		const vector<MatchedDocument> parallel_matched = server.MatchDocuments(execution::par, query);
+		ASSERT_EQUAL(parallel_matched.size(), matched.size());
+		for (size_t i = 0; i < matched.size(); ++i) {
+			ASSERT_EQUAL(parallel_matched[i].id, matched[i].id);
+			ASSERT(parallel_matched[i].words == matched[i].words);
+		}
+
+		const vector<int> document_ids = { 250, 3, 17, 3, 299, 0 };
+		for (const auto& subset : { server.MatchDocuments(query, document_ids), server.MatchDocuments(execution::par, query, document_ids) }) {
+			ASSERT_EQUAL(subset.size(), document_ids.size());
+			for (size_t i = 0; i < subset.size(); ++i) {
+				ASSERT_EQUAL(subset[i].id, document_ids[i]);
+				ASSERT(subset[i].words == get<0>(server.MatchDocument(query, document_ids[i])));
+			}
+		}
+	}
+
+	try {
+		server.MatchDocuments("cat"s, { 1, 5 });
+		ASSERT_HINT(false, "Removed documents must not match"s);
+	}
+	catch (const out_of_range&) {
+	}
+	try {
+		server.MatchDocuments("cat --dog"s);
+		ASSERT_HINT(false, "Invalid queries must throw"s);
+	}
+	catch (const invalid_argument&) {
+	}
+}
+
+void TestPreparedQuery() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 300);
+	const string raw_query = "cat curly and -dog cat"s;
+	const PreparedQuery query = server.PrepareQuery(raw_query);
+	ASSERT(query.GetPlusWords() == vector<string>({ "cat"s, "curly"s }));
+	ASSERT(query.GetMinusWords() == vector<string>({ "dog"s }));
+
+	const auto get_ids = [](const vector<Document>& documents) {
+		vector<int> ids;
+		for (const Document& document : documents) {
+			ids.push_back(document.id);
+		}
+		return ids;
+	};
+	const auto check_same_results = [&server, &raw_query, &query, &get_ids] {
+		const auto any = [](int, DocumentStatus, int) { return true; };
+		ASSERT(get_ids(server.FindTopDocuments(query)) == get_ids(server.FindTopDocuments(raw_query)));
+		ASSERT(get_ids(server.FindTopDocuments(execution::par, query, DocumentStatus::IRRELEVANT))
+			== get_ids(server.FindTopDocuments(raw_query, DocumentStatus::IRRELEVANT)));
+		ASSERT(get_ids(server.FindTopDocuments(search_policy::max_score, query, any, 20)) == get_ids(server.FindTopDocuments(raw_query, any, 20)));
+		for (const int document_id : { 0, 1, 2, 150 }) {
+			ASSERT(server.MatchDocument(query, document_id) == server.MatchDocument(raw_query, document_id));
+			ASSERT(server.MatchDocument(execution::par, query, document_id) == server.MatchDocument(raw_query, document_id));
+		}
+		const auto matched = server.MatchDocuments(execution::par, query);
+		const auto raw_matched = server.MatchDocuments(raw_query);
+		ASSERT_EQUAL(matched.size(), raw_matched.size());
+		for (size_t i = 0; i < matched.size(); ++i) {
+			ASSERT(matched[i].words == raw_matched[i].words);
+		}
+	};
+	check_same_results();
+
+	server.AddDocument(1000, "curly cat cat"s, DocumentStatus::ACTUAL, { 9 });
+	check_same_results();
+	const vector<int> found_ids = get_ids(server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000));
+	ASSERT_HINT(count(found_ids.begin(), found_ids.end(), 1000) == 1, "Stale prepared queries must see new documents"s);
+	server.RemoveDocument(1000);
+	check_same_results();
+
+	server.EnableQueryCache(16);
+	check_same_results();
+
+	SearchServer other_server("and with"s);
+	other_server.AddDocument(7, "dog curly"s, DocumentStatus::ACTUAL, { 1 });
+	other_server.AddDocument(8, "curly"s, DocumentStatus::ACTUAL, { 1 });
+	ASSERT_EQUAL_HINT(other_server.FindTopDocuments(query).size(), 1u, "Prepared queries must resolve on another server"s);
+
+	const vector<string> raw_queries = { "cat"s, "nasty -big"s, "tail eyes"s };
+	vector<PreparedQuery> queries;
+	for (const string& text : raw_queries) {
+		queries.push_back(server.PrepareQuery(text));
+	}
+	const auto prepared_results = ProcessQueries(server, queries);
+	const auto raw_results = ProcessQueries(server, raw_queries);
+	ASSERT_EQUAL(prepared_results.size(), raw_results.size());
+	for (size_t i = 0; i < raw_results.size(); ++i) {
+		ASSERT(get_ids(prepared_results[i]) == get_ids(raw_results[i]));
+	}
+	ASSERT(get_ids(ProcessQueriesJoined(server, queries)) == get_ids(ProcessQueriesJoined(server, raw_queries)));
+	try {
+		server.PrepareQuery("cat --dog"s);
+		ASSERT_HINT(false, "Invalid queries must throw on preparation"s);
+	}
+	catch (const invalid_argument&) {
+	}
+}
+
+void TestSyntheticCorpus() {
+	SyntheticCorpusOptions options;
+	options.document_count = 2000;
+	options.vocabulary_size = 1000;
+	options.words_per_document = 20;
+	SyntheticCorpus corpus(options);
+	ASSERT_EQUAL(corpus.GetTexts().size(), 2000u);
+	ASSERT_EQUAL(set<string>(corpus.GetVocabulary().begin(), corpus.GetVocabulary().end()).size(), 1000u);
+
+	SyntheticCorpus same_corpus(options);
+	ASSERT_HINT(corpus.GetTexts() == same_corpus.GetTexts(), "Same seed must give the same corpus"s);
+	ASSERT_HINT(corpus.GenerateQueries(100) == same_corpus.GenerateQueries(100), "Same seed must give the same queries"s);
+	options.seed = 7;
+	ASSERT(SyntheticCorpus(options).GetTexts() != corpus.GetTexts());
+
+	SearchServer server(""s);
+	server.AddDocuments(corpus.GetDocuments());
+	const auto document_freq = [&server](const string& word) {
+		return server.FindTopDocuments(word, [](int, DocumentStatus, int) { return true; }, 10000).size();
+	};
+	ASSERT_HINT(document_freq(corpus.GetVocabulary()[0]) > 5 * document_freq(corpus.GetVocabulary()[100]), "Word frequencies must be skewed"s);
+	ASSERT_HINT(!server.FindDuplicateDocuments().empty(), "Corpus must hold duplicates"s);
+
+	for (const string& query : corpus.GenerateQueries(100)) {
+		const size_t word_count = count(query.begin(), query.end(), ' ') + 1;
+		ASSERT(word_count == options.query_word_count || word_count == options.query_word_count + 1);
+	}
+}
+
+void TestBenchmark() {
+	const BenchmarkOptions options = ParseBenchmarkOptions({ "--documents=300"sv, "--vocabulary=200"sv, "--document-words=10"sv,
+		"--queries=100"sv, "--removes=50"sv, "--threads=2"sv, "--format=csv"sv });
+	ASSERT_EQUAL(options.corpus.document_count, 300u);
+	ASSERT_EQUAL(options.thread_count, 2u);
+	ASSERT(options.format == BenchmarkFormat::CSV);
+	try {
+		ParseBenchmarkOptions({ "--documents=many"sv });
+		ASSERT_HINT(false, "Invalid option values must throw"s);
+	}
+	catch (const invalid_argument&) {
+	}
+
+	const vector<BenchmarkResult> results = RunBenchmarks(options);
+	ASSERT_EQUAL(results.size(), 11u);
+	for (const BenchmarkResult& result : results) {
+		ASSERT(result.call_count > 0);
+		ASSERT(result.p50_ns <= result.p99_ns && result.p99_ns <= result.p999_ns && result.p999_ns <= result.max_ns);
+	}
+	ASSERT_EQUAL(results.front().operation_count, 300u);
+
+	ostringstream csv;
+	PrintBenchmarkResults(csv, options, results);
+	const string csv_text = csv.str();
+	ASSERT_EQUAL(static_cast<size_t>(count(csv_text.begin(), csv_text.end(), '\n')), results.size() + 1);
+	ostringstream json;
+	PrintBenchmarkResults(json, ParseBenchmarkOptions({}), results);
+	ASSERT(json.str().find("\"name\": \"ProcessQueries\""s) != string::npos);
+}
+
+void TestShardedSearchServer() {
+	SearchServer server("and with"s);
+	ShardedSearchServer sharded_server("and with"s, 4);
+	AddRandomDocuments(server, 300);
+	AddRandomDocuments(sharded_server, 300);
+	server.RemoveDocument(42);
+	sharded_server.RemoveDocument(42);
+	ASSERT_EQUAL_HINT(sharded_server.GetDocumentCount(), server.GetDocumentCount(), "All documents must be added to shards"s);
+
+	for (const string& query : { "cat pigeon"s, "cat hat -white"s, "pigeon eyes big -dog -tail"s }) {
+		const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+		for (const auto& found : { sharded_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20),
+			sharded_server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, 20) }) {
+			ASSERT_EQUAL_HINT(found.size(), expected.size(), "Sharded search must find the same number of documents"s);
+			for (size_t i = 0; i < expected.size(); ++i) {
+				ASSERT_EQUAL_HINT(found[i].id, expected[i].id, "Sharded search must keep the same order"s);
+				ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) < EPSILON, "Sharded search must use collection-wide IDF"s);
+			}
+		}
+	}
+	ASSERT_EQUAL_HINT(get<0>(sharded_server.MatchDocument("cat dog"s, 7)), get<0>(server.MatchDocument("cat dog"s, 7)), "Match must go to the owning shard"s);
+	ASSERT_EQUAL_HINT(sharded_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, numeric_limits<size_t>::max()).size(),
+		server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, numeric_limits<size_t>::max()).size(), "Shard merges must accept a huge result count"s);
+}
+
+void TestAddDocuments() {
+	const vector<string> words = { "cat"s, "dog"s, "curly"s, "tail"s, "nasty"s, "big"s, "eyes"s, "hat"s, "white"s, "pigeon"s };
+	vector<string> texts;
+	for (int document_id = 0; document_id < 300; ++document_id) {
+		texts.push_back(words[document_id % 10] + " with "s + words[document_id * 7 % 10] + " "s + words[document_id * 3 % 10]);
+	}
+	vector<RawDocument> documents;
+	for (int document_id = 0; document_id < 300; ++document_id) {
+		documents.push_back({ document_id, texts[document_id], DocumentStatus::ACTUAL, { document_id % 5 } });
+	}
+
+	SearchServer server("and with"s);
+	server.AddDocument(1000, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocuments(execution::par, documents);
+	ASSERT_EQUAL_HINT(server.GetDocumentCount(), 301, "All documents must be added"s);
+
+	SearchServer sequential_server("and with"s);
+	sequential_server.AddDocument(1000, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+	for (const RawDocument& document : documents) {
+		sequential_server.AddDocument(document.id, document.text, document.status, document.ratings);
+	}
+	ASSERT_EQUAL_HINT(server.GetWordFrequencies(7), sequential_server.GetWordFrequencies(7), "Bulk add must keep word frequencies"s);
+	for (const string& query : { "cat pigeon"s, "curly -white"s }) {
+		const auto expected = sequential_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+		const auto found = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 20);
+		ASSERT_EQUAL_HINT(found.size(), expected.size(), "Bulk add must find the same documents"s);
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQUAL_HINT(found[i].id, expected[i].id, "Bulk add must find the same documents"s);
+			ASSERT_HINT(abs(found[i].relevance - expected[i].relevance) < EPSILON, "Bulk add must keep relevance"s);
+		}
+	}
+
+	try {
+		server.AddDocuments({ { 2000, "big dog"sv, DocumentStatus::ACTUAL, { 1 } }, { 1000, "big cat"sv, DocumentStatus::ACTUAL, { 1 } } });
+		ASSERT_HINT(false, "Existing id must be rejected"s);
+	}
+	catch (const invalid_argument& e) {
+		ASSERT_EQUAL_HINT(e.what(), "invalid document id"s, "Existing id must be rejected"s);
+	}
+	try {
+		server.AddDocuments(execution::par, { { 2000, "big dog"sv, DocumentStatus::ACTUAL, { 1 } }, { 2001, "big c\x12t"sv, DocumentStatus::ACTUAL, { 1 } } });
+		ASSERT_HINT(false, "Bad words must be rejected"s);
+	}
+	catch (const invalid_argument& e) {
+		ASSERT_EQUAL_HINT(e.what(), "words has bad symbols"s, "Bad words must be rejected"s);
+	}
+	ASSERT_EQUAL_HINT(server.GetDocumentCount(), 301, "Failed batch must not add documents"s);
+}
+
+void TestTermCompaction() {
+	SearchServer server("and"s);
+	server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, { 1 });
+	server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 2 });
+	server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 3 });
+
+	// Terms left without documents are skipped until Compact drops them
+	server.RemoveDocument(3);
+	server.RemoveDocument(execution::par, 1);
+	ASSERT_HINT(server.IsCompactionDue(), "Most terms without documents must make compaction due"s);
+	ASSERT_HINT(server.FindTopDocuments("dog collar"s).empty(), "Dead terms must not match"s);
+	const auto found_before = server.FindTopDocuments("fluffy dog"s);
+	ASSERT_EQUAL_HINT(found_before.size(), 1u, "Live terms must match next to dead ones"s);
+	ASSERT_HINT(isfinite(found_before.front().relevance), "Dead terms must not break relevance"s);
+
+	// Compact renumbers the terms the prepared query was resolved to
+	const PreparedQuery prepared = server.PrepareQuery("tail cat -collar"s);
+	server.Compact();
+	ASSERT_HINT(!server.IsCompactionDue(), "Compaction must drop the dead terms"s);
+	ASSERT_HINT(server.FindTopDocuments("dog collar"s).empty(), "Dropped terms must not match"s);
+	const auto found_prepared = server.FindTopDocuments(execution::seq, prepared);
+	ASSERT_EQUAL_HINT(found_prepared.size(), 1u, "Prepared queries must survive compaction"s);
+	ASSERT_EQUAL_HINT(found_prepared.front().id, 2, "Prepared queries must survive compaction"s);
+	ASSERT_HINT(abs(found_prepared.front().relevance - server.FindTopDocuments("tail cat -collar"s).front().relevance) < EPSILON,
+		"Prepared queries must keep relevance after compaction"s);
+
+	const auto [words, status] = server.MatchDocument("fluffy cat tail dog"s, 2);
+	ASSERT_EQUAL_HINT(words, (vector<string_view>{ "cat"sv, "fluffy"sv, "tail"sv }), "Matching must use the renumbered terms"s);
+	ASSERT_EQUAL_HINT(server.GetWordFrequencies(2).size(), 3u, "Word frequencies must use the renumbered terms"s);
+
+	server.AddDocument(4, "dog with collar"s, DocumentStatus::ACTUAL, { 4 });
+	const auto found = server.FindTopDocuments("dog cat"s);
+	ASSERT_EQUAL_HINT(found.size(), 2u, "Dropped terms must be added anew"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments("collar"s).front().id, 4, "Dropped terms must be added anew"s);
+	ASSERT_EQUAL_HINT(server.FindTopDocuments(execution::par, "tail"s).front().id, 2, "Parallel search must use the renumbered terms"s);
+
+	// A term that comes back with a new document is live again and must not count as dead
+	SearchServer churn_server("and"s);
+	AddRandomDocuments(churn_server, 100);
+	for (int cycle = 0; cycle < 100; ++cycle) {
+		churn_server.AddDocument(1000 + cycle, "ephemerals"s, DocumentStatus::ACTUAL, { 1 });
+		churn_server.RemoveDocument(1000 + cycle);
+	}
+	ASSERT_HINT(!churn_server.IsCompactionDue(), "Re-adding a term must take it out of the dead terms"s);
+	ASSERT_EQUAL_HINT(churn_server.GetPendingRemovedCount(), 100u, "Removal must only leave tombstones"s);
+}
+
+void TestTombstoneCompaction() {
+	SearchServer server("and with"s);
+	SearchServer expected_server("and with"s);
+	AddRandomDocuments(server, 2000);
+	AddRandomDocuments(expected_server, 2000);
+	for (int document_id = 0; document_id < 2000; document_id += 20) {
+		server.RemoveDocument(document_id);
+		expected_server.RemoveDocument(document_id);
+	}
+	ASSERT_EQUAL_HINT(server.GetPendingRemovedCount(), 100u, "Removal must only leave tombstones"s);
+	ASSERT_HINT(!server.IsCompactionDue(), "A few tombstones must not make compaction due"s);
+
+	const auto check_same = [&](const string& hint) {
+		for (const string& query : { "cat dog"s, "pigeon eyes -dog"s, "curly tail"s }) {
+			const auto found = server.FindTopDocuments(search_policy::max_score, query, DocumentStatus::ACTUAL, 50);
+			const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+			ASSERT_EQUAL_HINT(found.size(), expected.size(), hint);
+			for (size_t i = 0; i < expected.size(); ++i) {
+				ASSERT_EQUAL_HINT(found[i].id, expected[i].id, hint);
+				ASSERT_HINT(found[i].id % 20 != 0, hint);
+			}
+		}
+	};
+	check_same("Queries must skip tombstones"s);
+	server.Compact();
+	ASSERT_EQUAL_HINT(server.GetPendingRemovedCount(), 0u, "Compaction must drop every tombstone"s);
+	check_same("Compaction must keep results"s);
+
+	// Compaction renumbers documents, so new documents and removals must still find theirs
+	vector<int> removed_ids;
+	for (int document_id = 1; document_id < 1200; document_id += 2) {
+		removed_ids.push_back(document_id);
+	}
+	server.RemoveDocuments(removed_ids);
+	expected_server.RemoveDocuments(removed_ids);
+	ASSERT_EQUAL_HINT(server.GetPendingRemovedCount(), removed_ids.size(), "Removal must not compact by itself"s);
+	ASSERT_HINT(server.IsCompactionDue(), "Many tombstones must make compaction due"s);
+	server.Compact();
+	ASSERT_EQUAL_HINT(server.GetPendingRemovedCount(), 0u, "Compaction must drop every tombstone"s);
+	check_same("Renumbered documents must keep results"s);
+	ASSERT_EQUAL_HINT(server.GetWordFrequencies(1999), expected_server.GetWordFrequencies(1999), "Renumbered documents must keep their words"s);
+	for (SearchServer* target : { &server, &expected_server }) {
+		target->AddDocument(5001, "curly cat with curly tail"s, DocumentStatus::ACTUAL, { 3 });
+		target->RemoveDocument(1998);
+	}
+	ASSERT_EQUAL_HINT(server.GetDocumentCount(), expected_server.GetDocumentCount(), "Ids must map to the renumbered documents"s);
+	check_same("Documents added after compaction must be found"s);
+}
+
+void TestSaveLoad() {
+	SearchServer server("and with"s);
+	AddRandomDocuments(server, 1000);
+	server.AddDocument(2000, "white cat and fancy collar"s, DocumentStatus::BANNED, { 7 });
+	server.AddDocument(2001, "dog with expressive eyes"s, DocumentStatus::ACTUAL, { 2 });
+	server.RemoveDocument(2001);
+	server.RemoveDocument(17);
+	server.AddDocument(17, "cat"s, DocumentStatus::ACTUAL, { 5 });
+
+	const TempFile index_file("search_server_test_save_load.idx"s);
+	const string& path = index_file.GetPath();
+	server.Save(path);
+	const SearchServer loaded = SearchServer::Load(path);
+
+	ASSERT_EQUAL_HINT(loaded.GetDocumentCount(), server.GetDocumentCount(), "Loaded index must keep every document"s);
+	for (const string& query : { "cat dog -fancy"s, "white collar"s, "expressive eyes cat"s }) {
+		const auto expected = server.FindTopDocuments(query);
+		const auto actual = loaded.FindTopDocuments(query);
+		ASSERT_EQUAL_HINT(actual.size(), expected.size(), "Loaded index must find the same number of documents"s);
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, "Loaded index must keep the same order"s);
+			ASSERT_HINT(abs(actual[i].relevance - expected[i].relevance) < EPSILON, "Loaded index must keep relevance"s);
+		}
+	}
+	ASSERT_HINT(loaded.FindTopDocuments("expressive"s).empty(), "Removed documents must stay removed after loading"s);
+	ASSERT_EQUAL_HINT(get<0>(loaded.MatchDocument("fancy cat and"s, 2000)), (vector<string_view>{ "cat"sv, "fancy"sv }),
+		"Loaded index must match documents of any status"s);
+	ASSERT_EQUAL_HINT(get<0>(loaded.MatchDocument("cat"s, 17)).size(), 1u, "A re-added document must be saved with its new text"s);
+	ASSERT_HINT(loaded.GetWordFrequencies(2001).empty(), "Removed documents must have no words after loading"s);
+
+	try {
+		const TempFile missing_file("search_server_test_missing.idx"s);
+		SearchServer::Load(missing_file.GetPath());
+		ASSERT_HINT(false, "missing file must throw"s);
+	}
+	catch (const runtime_error&) {
+	}
+
+	// Damaged files must be rejected or loaded, never read out of bounds
+	SearchServer small_server(""s);
+	AddRandomDocuments(small_server, 300);
+	small_server.Save(path);
+	string data;
+	{
+		ifstream in(path, ios::binary);
+		data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	}
+	for (size_t pos = 8; pos < data.size(); pos += 3) {
+		string damaged = data;
+		damaged[pos] = static_cast<char>(damaged[pos] ^ (pos % 2 == 0 ? 0x7F : 0x80));
+		{
+			ofstream out(path, ios::binary | ios::trunc);
+			out << damaged;
+		}
+		try {
+			const SearchServer damaged_server = SearchServer::Load(path);
+			damaged_server.FindTopDocuments("cat dog"s);
+		}
+		catch (const runtime_error&) {
+		}
+		catch (const invalid_argument&) {
+		}
+	}
+}
+
+void TestLoadCorpus() {
+	const TempFile corpus_file("search_server_test_corpus.txt"s);
+	{
+		ofstream out(corpus_file.GetPath(), ios::binary);
+		for (int document_id = 0; document_id < 200; ++document_id) {
+			out << document_id << '\t' << document_id % 3 << '\t' << document_id % 7 << ' ' << 1 << '\t'
+				<< (document_id % 2 == 0 ? "white cat"s : "curly dog"s) << " number"s << document_id << "\r\n"s;
+		}
+	}
+	SearchServer server("and with"s);
+	ASSERT_EQUAL_HINT(LoadCorpus(server, corpus_file.GetPath(), 256), 200u, "Every line must be loaded across chunk borders"s);
+
+	ASSERT_EQUAL_HINT(server.GetDocumentCount(), 200, "Every loaded document must be added"s);
+	const auto found = server.FindTopDocuments("number42"s, DocumentStatus::ACTUAL);
+	ASSERT_EQUAL_HINT(found.size(), 1u, "Words must not run into the CRLF line ends"s);
+	ASSERT_EQUAL_HINT(found.front().id, 42, "Ids must be read from the first column"s);
+	ASSERT_EQUAL_HINT(found.front().rating, 0, "Ratings must be read from the third column"s);
+	ASSERT_EQUAL_HINT(get<1>(server.MatchDocument("cat"s, 43)), DocumentStatus::IRRELEVANT, "Statuses must be read from the second column"s);
+	ASSERT_EQUAL_HINT(server.GetWordFrequencies(43).size(), 3u, "Loaded texts must be indexed word by word"s);
+
+	const auto documents = ParseCorpus("7\t2\t\tbig eyes\n\n8\t0\t-3 5\t\n"sv);
+	ASSERT_EQUAL_HINT(documents.size(), 2u, "Empty lines must be skipped"s);
+	ASSERT_EQUAL_HINT(documents[0].text, "big eyes"sv, "Text must be the fourth column"s);
+	ASSERT_HINT(documents[0].ratings.empty(), "An empty rating column must give no ratings"s);
+	ASSERT_EQUAL_HINT(documents[1].ratings, (vector<int>{ -3, 5 }), "Ratings must be separated by spaces"s);
+	for (const string_view line : { "1\t0\tbig eyes"sv, "x\t0\t1\tbig eyes"sv, "1\t9\t1\tbig eyes"sv }) {
+		try {
+			ParseCorpus(line);
+			ASSERT_HINT(false, "Bad corpus line must be rejected"s);
+		}
+		catch (const invalid_argument&) {
+		}
+	}
+}
+
 void TestSearchServer() {
 	RUN_TEST(TestConstructor);
 	RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -484,9 +1419,34 @@ void TestSearchServer() {
 	RUN_TEST(TestGetDocumentIDException);
 	RUN_TEST(TestPagination);
 	RUN_TEST(TestRequestQueue);
+	RUN_TEST(TestConcurrentRequestQueue);
 	RUN_TEST(TestGetWordFrequencies);
 	RUN_TEST(TestRemoveDocument);
 	RUN_TEST(TestDeleteDuplicate);
+	RUN_TEST(TestFindDuplicateDocuments);
+	RUN_TEST(TestPostingsOrder);
+	RUN_TEST(TestTermDictionary);
+	RUN_TEST(TestMaxResultCount);
+	RUN_TEST(TestMaxScorePolicy);
+	RUN_TEST(TestParallelFind);
+	RUN_TEST(TestRelevanceAfterRemove);
+	RUN_TEST(TestPostingListCompression);
+	RUN_TEST(TestTokenize);
+	RUN_TEST(TestStopWordSet);
+	RUN_TEST(TestThreadPool);
+	RUN_TEST(TestQueryCache);
+	RUN_TEST(TestSnapshotSearchServer);
+	RUN_TEST(TestLatencyHistogram);
+	RUN_TEST(TestMatchDocuments);
+	RUN_TEST(TestPreparedQuery);
+	RUN_TEST(TestSyntheticCorpus);
+	RUN_TEST(TestBenchmark);
+	RUN_TEST(TestShardedSearchServer);
+	RUN_TEST(TestAddDocuments);
+	RUN_TEST(TestTermCompaction);
+	RUN_TEST(TestTombstoneCompaction);
+	RUN_TEST(TestSaveLoad);
+	RUN_TEST(TestLoadCorpus);
 	cerr << "Search server testing finished"s << endl;
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <map>
@@ -114,6 +115,50 @@ void RunTestImpl(const T& expr, const std::string& function_name) {
 #define RUN_TEST(func)  RunTestImpl((func), #func)
 
 
+template <typename Server>
+void AddRandomDocuments(Server& server, int document_count) {
+	const std::vector<std::string> words = { "cat", "dog", "curly", "tail", "nasty", "big", "eyes", "hat", "white", "pigeon" };
+	unsigned seed = 42;
+	const auto next_random = [&seed](unsigned bound) {
+		seed = seed * 1103515245u + 12345u;
+		return (seed >> 16) % bound;
+	};
+	for (int document_id = 0; document_id < document_count; ++document_id) {
+		std::string text;
+		const unsigned word_count = 1 + next_random(8);
+		for (unsigned i = 0; i < word_count; ++i) {
+			// Skewed choice: low indices are far more frequent
+			text += words[next_random(1 + next_random(words.size()))] + " ";
+		}
+		text.pop_back();
+		server.AddDocument(document_id, text, static_cast<DocumentStatus>(next_random(2)), { static_cast<int>(next_random(10)) });
+	}
+}
+
+// A path in the temporary directory; the file, if any, is removed with the object
+class TempFile {
+public:
+	explicit TempFile(const std::string& name)
+		: path_((std::filesystem::temp_directory_path() / name).string()) {
+	}
+
+	TempFile(const TempFile&) = delete;
+	TempFile& operator=(const TempFile&) = delete;
+
+	~TempFile() {
+		std::error_code error;
+		std::filesystem::remove(path_, error);
+	}
+
+	const std::string& GetPath() const {
+		return path_;
+	}
+
+private:
+	std::string path_;
+};
+
+
 void TestConstructor();
 
 void TestExcludeStopWordsFromAddedDocumentContent();
@@ -146,12 +191,62 @@ void TestPagination();
 
 void TestRequestQueue();
 
+void TestConcurrentRequestQueue();
+
 void TestGetWordFrequencies();
 
 void TestRemoveDocument();
 
 void TestDeleteDuplicate();
 
+void TestFindDuplicateDocuments();
+
+void TestPostingsOrder();
+
+void TestTermDictionary();
+
+void TestMaxResultCount();
+
+void TestMaxScorePolicy();
+
+void TestParallelFind();
+
+void TestRelevanceAfterRemove();
+
+void TestPostingListCompression();
+
+void TestTokenize();
+
+void TestStopWordSet();
+
+void TestThreadPool();
+
+void TestQueryCache();
+
+void TestSnapshotSearchServer();
+
+void TestLatencyHistogram();
+
+void TestMatchDocuments();
+
+void TestPreparedQuery();
+
+void TestSyntheticCorpus();
+
+void TestBenchmark();
+
+void TestShardedSearchServer();
+
+void TestAddDocuments();
+
+void TestTermCompaction();
+
+void TestTombstoneCompaction();
+
+void TestSaveLoad();
+
+void TestLoadCorpus();
+
 void TestSearchServer();
 
 
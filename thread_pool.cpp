@@ -0,0 +1,139 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+namespace {
+	thread_local const ThreadPool* current_pool = nullptr;
+	thread_local size_t current_worker = 0;
+
+	mutex default_pool_mutex;
+	size_t default_thread_count = 0;
+	bool is_default_pool_created = false;
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+	: queues_(max<size_t>(thread_count, 1) + 1) {
+	workers_.reserve(queues_.size() - 1);
+	for (size_t i = 0; i + 1 < queues_.size(); ++i) {
+		workers_.emplace_back([this, i] {
+			WorkerLoop(i);
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard guard(sleep_mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (thread& worker : workers_) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::GetThreadCount() const {
+	return workers_.size();
+}
+
+ThreadPool& ThreadPool::GetDefault() {
+	// The mutex is taken only while the pool is created
+	static ThreadPool pool([] {
+		lock_guard guard(default_pool_mutex);
+		is_default_pool_created = true;
+		return default_thread_count > 0 ? default_thread_count : thread::hardware_concurrency();
+	}());
+	return pool;
+}
+
+void ThreadPool::SetDefaultThreadCount(size_t thread_count) {
+	lock_guard guard(default_pool_mutex);
+	if (is_default_pool_created) {
+		throw logic_error("default thread pool is already running");
+	}
+	default_thread_count = thread_count;
+}
+
+void ThreadPool::Push(Task task) {
+	const size_t queue = current_pool == this ? current_worker : queues_.size() - 1;
+	{
+		lock_guard guard(queues_[queue].mutex);
+		queues_[queue].tasks.push_back(move(task));
+	}
+	queued_task_count_.fetch_add(1, memory_order_release);
+	{
+		// Taking the lock orders the push before a worker's check of the predicate
+		lock_guard guard(sleep_mutex_);
+	}
+	wake_.notify_one();
+}
+
+void ThreadPool::WakeAll() {
+	{
+		// Taking the lock orders the change before a sleeper's check of its predicate
+		lock_guard guard(sleep_mutex_);
+	}
+	wake_.notify_all();
+}
+
+bool ThreadPool::RunQueuedTask() {
+	Task task;
+	if (!PopTask(task)) {
+		return false;
+	}
+	task();
+	return true;
+}
+
+bool ThreadPool::PopTask(Task& task) {
+	if (queued_task_count_.load(memory_order_acquire) == 0) {
+		return false;
+	}
+	const size_t queue_count = queues_.size();
+	const size_t own = current_pool == this ? current_worker : queue_count - 1;
+	{
+		auto& queue = queues_[own];
+		lock_guard guard(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = move(queue.tasks.back());
+			queue.tasks.pop_back();
+			queued_task_count_.fetch_sub(1, memory_order_relaxed);
+			return true;
+		}
+	}
+	for (size_t offset = 1; offset < queue_count; ++offset) {
+		auto& queue = queues_[(own + offset) % queue_count];
+		lock_guard guard(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = move(queue.tasks.front());
+			queue.tasks.pop_front();
+			queued_task_count_.fetch_sub(1, memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+	current_pool = this;
+	current_worker = index;
+	while (true) {
+		if (RunQueuedTask()) {
+			continue;
+		}
+		unique_lock lock(sleep_mutex_);
+		wake_.wait(lock, [this] {
+			return stop_ || queued_task_count_.load(memory_order_acquire) > 0;
+		});
+		if (stop_) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a task deque, takes its own newest task first
+// and steals the oldest tasks of others when it runs dry. Threads waiting in ParallelFor
+// run tasks too, so parallel loops nest without deadlock and share the same workers.
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	size_t GetThreadCount() const;
+
+	// Calls function(i) for every i in [0, count) and returns when all calls are done.
+	// The first exception thrown by a call is rethrown here
+	template <typename Function>
+	void ParallelFor(size_t count, Function function);
+
+	// Pool used by the parallel overloads of SearchServer and by ProcessQueries
+	static ThreadPool& GetDefault();
+	// Sets the size of the default pool; throws logic_error once the pool exists
+	static void SetDefaultThreadCount(size_t thread_count);
+
+private:
+	using Task = std::function<void()>;
+
+	struct alignas(64) TaskQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	// Queues of the workers followed by the queue for tasks from other threads
+	std::vector<TaskQueue> queues_;
+	std::vector<std::thread> workers_;
+	std::atomic<size_t> queued_task_count_{ 0 };
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_;
+	bool stop_ = false;
+
+	void Push(Task task);
+	void WakeAll();
+	bool RunQueuedTask();
+	bool PopTask(Task& task);
+	void WorkerLoop(size_t index);
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function function) {
+	if (count == 0) {
+		return;
+	}
+	if (count == 1 || workers_.empty()) {
+		for (size_t i = 0; i < count; ++i) {
+			function(i);
+		}
+		return;
+	}
+
+	struct Loop {
+		std::atomic<size_t> remaining;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	} loop;
+	loop.remaining = count;
+
+	// The caller takes index 0 itself, the others become tasks
+	for (size_t i = 1; i < count; ++i) {
+		Push([this, &loop, &function, i] {
+			try {
+				function(i);
+			}
+			catch (...) {
+				std::lock_guard guard(loop.error_mutex);
+				if (!loop.error) {
+					loop.error = std::current_exception();
+				}
+			}
+			if (loop.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				WakeAll();
+			}
+		});
+	}
+	try {
+		function(0);
+	}
+	catch (...) {
+		std::lock_guard guard(loop.error_mutex);
+		if (!loop.error) {
+			loop.error = std::current_exception();
+		}
+	}
+	loop.remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+	while (loop.remaining.load(std::memory_order_acquire) > 0) {
+		if (RunQueuedTask()) {
+			continue;
+		}
+		// Nothing left to help with: sleep until the loop ends or new tasks arrive
+		std::unique_lock lock(sleep_mutex_);
+		wake_.wait(lock, [this, &loop] {
+			return loop.remaining.load(std::memory_order_acquire) == 0 || queued_task_count_.load(std::memory_order_acquire) > 0;
+		});
+	}
+	if (loop.error) {
+		std::rethrow_exception(loop.error);
+	}
+}
@@ -0,0 +1,123 @@
+#include "tokenizer.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#define TOKENIZER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define TOKENIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+	bool IsControlChar(char c) {
+		return c >= '\0' && c < ' ';
+	}
+
+	// Bit i of the masks stands for byte i of the block
+	struct BlockMasks {
+		uint32_t spaces;
+		uint32_t control_chars;
+	};
+
+#if defined(TOKENIZER_AVX2)
+	const size_t BLOCK_SIZE = 32;
+
+	BlockMasks ScanBlock(const char* data) {
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+		const __m256i spaces = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+		// Signed compares: bytes 0x80..0xFF are negative and stay valid
+		const __m256i control_chars = _mm256_and_si256(
+			_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(-1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(' '), bytes));
+		return { static_cast<uint32_t>(_mm256_movemask_epi8(spaces)), static_cast<uint32_t>(_mm256_movemask_epi8(control_chars)) };
+	}
+#elif defined(TOKENIZER_SSE2)
+	const size_t BLOCK_SIZE = 16;
+
+	BlockMasks ScanBlock(const char* data) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		const __m128i spaces = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+		// Signed compares: bytes 0x80..0xFF are negative and stay valid
+		const __m128i control_chars = _mm_and_si128(
+			_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-1)),
+			_mm_cmplt_epi8(bytes, _mm_set1_epi8(' ')));
+		return { static_cast<uint32_t>(_mm_movemask_epi8(spaces)), static_cast<uint32_t>(_mm_movemask_epi8(control_chars)) };
+	}
+#else
+	const size_t BLOCK_SIZE = 8;
+
+	BlockMasks ScanBlock(const char* data) {
+		BlockMasks masks = { 0, 0 };
+		for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+			masks.spaces |= static_cast<uint32_t>(data[i] == ' ') << i;
+			masks.control_chars |= static_cast<uint32_t>(IsControlChar(data[i])) << i;
+		}
+		return masks;
+	}
+#endif
+
+	int CountTrailingZeros(uint32_t mask) {
+#if defined(__GNUC__)
+		return __builtin_ctz(mask);
+#else
+		int count = 0;
+		for (; (mask & 1) == 0; mask >>= 1) {
+			++count;
+		}
+		return count;
+#endif
+	}
+}
+
+bool Tokenize(string_view text, vector<string_view>& words) {
+	words.clear();
+	if (text.empty()) {
+		return true;
+	}
+
+	const char* data = text.data();
+	const size_t size = text.size();
+	bool has_control_chars = false;
+	size_t word_begin = 0;
+	size_t pos = 0;
+	for (; pos + BLOCK_SIZE <= size; pos += BLOCK_SIZE) {
+		const BlockMasks masks = ScanBlock(data + pos);
+		has_control_chars |= masks.control_chars != 0;
+		for (uint32_t spaces = masks.spaces; spaces != 0; spaces &= spaces - 1) {
+			const size_t space = pos + CountTrailingZeros(spaces);
+			words.emplace_back(data + word_begin, space - word_begin);
+			word_begin = space + 1;
+		}
+	}
+	for (; pos < size; ++pos) {
+		has_control_chars |= IsControlChar(data[pos]);
+		if (data[pos] == ' ') {
+			words.emplace_back(data + word_begin, pos - word_begin);
+			word_begin = pos + 1;
+		}
+	}
+	words.emplace_back(data + word_begin, size - word_begin);
+	return !has_control_chars;
+}
+
+bool HasControlChars(string_view text) {
+	const char* data = text.data();
+	size_t pos = 0;
+	for (; pos + BLOCK_SIZE <= text.size(); pos += BLOCK_SIZE) {
+		if (ScanBlock(data + pos).control_chars != 0) {
+			return true;
+		}
+	}
+	for (; pos < text.size(); ++pos) {
+		if (IsControlChar(data[pos])) {
+			return true;
+		}
+	}
+	return false;
+}
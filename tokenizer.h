@@ -0,0 +1,11 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+// Splits text on spaces in one pass that also checks for control characters (bytes 0..31).
+// Adjacent spaces give empty words, as with repeated find(' '); empty text gives no words.
+// words is cleared first, so callers can keep reusing one buffer.
+// Returns false if the text has a control character
+bool Tokenize(std::string_view text, std::vector<std::string_view>& words);
+
+bool HasControlChars(std::string_view text);
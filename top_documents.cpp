@@ -0,0 +1,48 @@
+#include "top_documents.h"
+#include "document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+TopDocuments::TopDocuments(size_t max_count)
+	: max_count_(max_count) {
+	heap_.reserve(min(max_count, MAX_RESERVED_COUNT));
+}
+
+bool TopDocuments::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+	if (abs(lhs.relevance - rhs.relevance) < 1e-6) {
+		if (lhs.rating == rhs.rating) {
+			return lhs.id < rhs.id;
+		}
+		return lhs.rating > rhs.rating;
+	}
+	return lhs.relevance > rhs.relevance;
+}
+
+void TopDocuments::Add(const Document& document) {
+	if (heap_.size() < max_count_) {
+		heap_.push_back(document);
+		push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	}
+	else if (max_count_ > 0 && IsMoreRelevant(document, heap_.front())) {
+		pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+		heap_.back() = document;
+		push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	}
+}
+
+bool TopDocuments::IsFull() const {
+	return max_count_ > 0 && heap_.size() == max_count_;
+}
+
+const Document& TopDocuments::GetWorst() const {
+	return heap_.front();
+}
+
+vector<Document> TopDocuments::Extract() {
+	sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	return move(heap_);
+}
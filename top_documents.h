@@ -0,0 +1,27 @@
+#pragma once
+#include "document.h"
+
+#include <cstddef>
+#include <vector>
+
+class TopDocuments {
+public:
+	explicit TopDocuments(size_t max_count);
+
+	static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+	void Add(const Document& document);
+
+	bool IsFull() const;
+	const Document& GetWorst() const;
+
+	std::vector<Document> Extract();
+
+private:
+	// A limit is only an upper bound, often far above the number of matches,
+	// so the heap starts at most this large and grows as documents come
+	static constexpr size_t MAX_RESERVED_COUNT = 64;
+
+	size_t max_count_;
+	std::vector<Document> heap_;
+};